@@ -21,117 +21,194 @@ namespace nrf24l01 {
     /**
      * \brief ADT for NRF addresses
      *
-     * Implements equality checks, and some useful constructors, relating to the way addresses are set in an NRF24l01
+     * Implements equality checks, and some useful constructors, relating to the way addresses are set in an NRF24l01.
+     * An address is 3 to 5 bytes wide (see nrf24l01plus::address_width(uint8_t)). It is stored as a single packed integer:
+     * the address bytes in the lower 40 bits, with the last (least significant) byte in the lowest 8 bits, and the width
+     * in the upper 8 bits. Bytes outside the width are always 0, so comparing and hashing don't need any loops or branches.
+     * All constructors are constexpr, so addresses can be constants.
+     * A width outside 3-5 is taken as 5, the width the module starts with.
      */
     class address {
+        uint64_t packed;
+
+        static constexpr uint8_t valid_width(uint8_t width) {
+            return width < MIN_WIDTH || width > MAX_WIDTH ? MAX_WIDTH : width;
+        }
+
+        static constexpr uint64_t mask(uint8_t width) {
+            return width >= 8 ? ~uint64_t(0) : (uint64_t(1) << (8 * width)) - 1;
+        }
+
     public:
-        /// All 5 bytes of this address
-        uint8_t address_bytes[5];
+        //! Smallest address width in bytes
+        static constexpr const uint8_t MIN_WIDTH = 3;
+        //! Largest address width in bytes
+        static constexpr const uint8_t MAX_WIDTH = 5;
+
+        /**
+         * \brief Construct an address from its packed value
+         * @param value Address bytes, the last byte in the lowest 8 bits. Bits outside the width are ignored
+         * @param width Address width in bytes, 3-5, other widths are taken as 5
+         */
+        constexpr explicit address(uint64_t value, uint8_t width = MAX_WIDTH) :
+                packed((value & mask(valid_width(width))) | uint64_t(valid_width(width)) << 56) {}
 
         /**
          * \brief Basic constructor
          *
-         * Construct an NRF address using it's bytes
-         * @param byteAddress Address Bytes
+         * Construct a 5 byte NRF address using it's bytes
+         * @param byteAddress Address Bytes, first byte first
          */
-        address(uint8_t byteAddress[5]) : address_bytes{0} {
-            for (size_t i = 0; i < 5; i++) {
-                address_bytes[i] = byteAddress[i];
-            }
-        }
+        constexpr address(const uint8_t byteAddress[5]) :
+                address(byteAddress[0], byteAddress[1], byteAddress[2], byteAddress[3], byteAddress[4]) {}
 
         /**
          * \brief Create an empty Address
          */
-        address() : address_bytes{0, 0, 0, 0, 0} {
-
-        }
+        constexpr address() : address(uint64_t(0)) {}
 
         /**
-         * \brief Construct an address using seperate bytes
+         * \brief Construct a 5 byte address using seperate bytes
          * @param byte_1 First byte
          * @param byte_2 Second byte
          * @param byte_3 Third byte
          * @param byte_4 Fourth byte
          * @param byte_5 Fifth byte
          */
-        address(const uint8_t &byte_1, const uint8_t &byte_2, const uint8_t &byte_3, const uint8_t &byte_4,
-                const uint8_t &byte_5) : address_bytes{byte_1, byte_2, byte_3, byte_4, byte_5} {}
+        constexpr address(const uint8_t &byte_1, const uint8_t &byte_2, const uint8_t &byte_3, const uint8_t &byte_4,
+                          const uint8_t &byte_5) :
+                address(uint64_t(byte_1) << 32 | uint64_t(byte_2) << 24 | uint64_t(byte_3) << 16 |
+                        uint64_t(byte_4) << 8 | byte_5) {}
 
         /**
          * \brief Construct an address using a base address
          *
-         * Uses the  first 4 bytes of the given address, and adds in a fifth byte
+         * Uses all but the last byte of the given address, and adds in a last byte. The width of the base is kept.
          * @param base Address to base on
-         * @param end Fifth byte to set
+         * @param end Last byte to set
          */
-        address(const address &base, uint8_t end) : address_bytes{0} {
-            for (size_t i = 0; i < 4; i++) {
-                address_bytes[i] = base.address_bytes[i];
+        constexpr address(const address &base, uint8_t end) : packed((base.packed & ~uint64_t(0xFF)) | end) {}
+
+        /**
+         * \brief Construct an address from bytes in the order they are sent over SPI (LSByte first)
+         * @param bytes The address bytes, width bytes (at most 5 are read)
+         * @param width Address width in bytes, 3-5, other widths are taken as 5
+         * @return The address
+         */
+        static constexpr address from_bytes(const uint8_t *bytes, uint8_t width = MAX_WIDTH) {
+            uint64_t value = 0;
+            for (uint8_t i = 0; i < width && i < MAX_WIDTH; i++) {
+                value |= uint64_t(bytes[i]) << (8 * i);
             }
-            address_bytes[4] = end;
+            return address(value, width);
+        }
+
+        /**
+         * \brief Write the address bytes in the order they are sent over SPI (LSByte first)
+         *
+         * Always writes 5 bytes, bytes outside the width are 0
+         * @param out Memory to write the bytes into, at least 5 bytes
+         */
+        constexpr void to_bytes(uint8_t *out) const {
+            for (uint8_t i = 0; i < MAX_WIDTH; i++) {
+                out[i] = uint8_t(packed >> (8 * i));
+            }
+        }
+
+        /**
+         * \brief Packed address bytes, the last byte in the lowest 8 bits
+         */
+        constexpr uint64_t value() const {
+            return packed & mask(MAX_WIDTH);
+        }
+
+        /**
+         * \brief Address width in bytes
+         */
+        constexpr uint8_t width() const {
+            return uint8_t(packed >> 56);
+        }
+
+        /**
+         * \brief Last (least significant) byte, the byte that differs between pipes 1 to 5
+         */
+        constexpr uint8_t last_byte() const {
+            return uint8_t(packed);
+        }
+
+        /**
+         * \brief The same address with another width, keeping the last bytes
+         * @param width New address width in bytes, 3-5, other widths are taken as 5
+         */
+        constexpr address with_width(uint8_t width) const {
+            return address(value(), width);
+        }
+
+        /**
+         * \brief Hash of the address, for use in hash tables
+         *
+         * Fibonacci hashing of the packed value, so addresses that only differ in their last byte spread well
+         */
+        constexpr uint32_t hash() const {
+            return uint32_t((packed * 0x9E3779B97F4A7C15ull) >> 32);
         }
 
         /**
          * \brief Check for full equality with another address
          * @param rhs Address to compare to
-         * @return True if all bytes in the addresses are equal
+         * @return True if the widths and all bytes in the addresses are equal
          */
-        bool operator==(const address &rhs) const {
-            for (size_t i = 0; i < 5; i++) {
-                if (address_bytes[i] != rhs.address_bytes[i]) {
-                    return false;
-                }
-
-            }
-            return true;
+        constexpr bool operator==(const address &rhs) const {
+            return packed == rhs.packed;
         }
 
         /**
          * \brief Compare an address to a byte value
          *
-         * Returns true if the fifth byte of the address is equal to the byte value
+         * Returns true if the last byte of the address is equal to the byte value
          * @param rhs Byte value to compare to
-         * @return True if the fifth byte is equal to the value
+         * @return True if the last byte is equal to the value
          */
-        bool operator==(const uint8_t &rhs) const {
-            return (address_bytes[4] == rhs);
+        constexpr bool operator==(const uint8_t &rhs) const {
+            return last_byte() == rhs;
         }
 
         /**
          * \brief Check for inequality with a byte value
          *
-         * Returns true if the fifth byte of the address is inequal to the byte value
+         * Returns true if the last byte of the address is inequal to the byte value
          * @param rhs Byte value to compare to
-         * @return True if the fifth byte is inequal to the value
+         * @return True if the last byte is inequal to the value
          */
-        bool operator!=(const uint8_t &rhs) const {
+        constexpr bool operator!=(const uint8_t &rhs) const {
             return !(*this == rhs);
         }
 
         /**
          * \brief Inequality operator for two nrf_addresses
          *
-         * Checks for full equality of all address bytes
+         * Checks for full equality of the widths and all address bytes
          * @param rhs Address to compare to
-         * @return True if all address bytes are equal
+         * @return True if any address byte or the width differs
          */
-        bool operator!=(const address &rhs) const {
+        constexpr bool operator!=(const address &rhs) const {
             return !(rhs == *this);
         }
 
         /**
          * \brief Print an address to an ostream
          *
-         * Prints all address bytes in hexadecimal representation
+         * Prints all address bytes in hexadecimal representation, first byte first
          * @param os Stream to output to
          * @param address Address to output
          * @return The ostream, with data fed into it
          */
         friend hwlib::ostream &operator<<(hwlib::ostream &os, const address &address) {
-            os << "address_bytes: " << hwlib::hex << address.address_bytes[0] << " " << address.address_bytes[1] << " "
-               << address.address_bytes[2] << " " << address.address_bytes[3] << " " << address.address_bytes[4] << " "
-               << hwlib::dec;
+            os << "address_bytes: " << hwlib::hex;
+            for (uint8_t i = address.width(); i > 0; i--) {
+                os << uint8_t(address.packed >> (8 * (i - 1))) << " ";
+            }
+            os << hwlib::dec;
             return os;
         }
     };
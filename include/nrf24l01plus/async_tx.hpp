@@ -0,0 +1,218 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_ASYNC_TX_HPP
+#define PROJECT_NRF24L01_ASYNC_TX_HPP
+
+#include <atomic>
+#include <nrf24l01plus/nrf24l01plus.hpp>
+#include <nrf24l01plus/irq.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Interface for objects that want to know the result of an asynchronous transmission
+     */
+    class tx_completion_listener {
+    public:
+        /**
+         * \brief Called when a transmission has finished
+         * @param success True if the payload was sent (and acknowledged, if an acknowledgement was requested)
+         * @param retries Amount of retransmissions that were needed (ARC_CNT)
+         */
+        virtual void tx_complete(bool success, uint8_t retries) = 0;
+    };
+
+    /**
+     * \brief Non-blocking transmitter, driven by poll() calls and (optionally) interrupts
+     *
+     * Instead of waiting for the module to settle and for the transmission to finish, every step has a deadline,
+     * and poll() advances to the next state when its deadline has passed or the module reported an event.
+     *
+     * When irq_driven is set, the transmitter should be added to an irq_dispatcher, and it relies on the dispatcher
+     * to read and clear TX_DS and MAX_RT. Otherwise poll() reads the status register itself while awaiting an acknowledgement.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class async_transmitter : public irq_listener {
+    public:
+        /**
+         * \brief States of an asynchronous transmission
+         */
+        enum class state : uint8_t {
+            //! Nothing has been sent yet
+            idle,
+            //! Waiting for the module to settle in PTX mode
+            settling,
+            //! CE is asserted, the transmission is starting
+            transmitting,
+            //! Waiting for TX_DS or MAX_RT
+            awaiting_ack,
+            //! The last transmission succeeded
+            done,
+            //! The last transmission failed
+            failed
+        };
+
+        //! Time to wait for TX_DS or MAX_RT before giving up, in microseconds
+        uint_fast64_t ack_timeout_us = 100000;
+
+    private:
+        Radio &nrf;
+        bool irq_driven;
+        tx_completion_listener *listener = nullptr;
+        state current = state::idle;
+        uint_fast64_t deadline = 0;
+        std::atomic<uint8_t> events{0};
+        uint8_t retries = 0;
+
+    public:
+        /**
+         * \brief Create an asynchronous transmitter
+         * @param nrf The module to transmit on
+         * @param irq_driven True if this transmitter is added to an irq_dispatcher
+         */
+        explicit async_transmitter(Radio &nrf, bool irq_driven = false) : nrf(nrf), irq_driven(irq_driven) {}
+
+        /**
+         * \brief Start sending a payload
+         *
+         * Switches the module to PTX mode if needed, without waiting for it to settle.
+         * For using NOACK, the feature needs to be enabled in the FEATURE register
+         * @param data Memory location to write data from
+         * @param size Size of the data to write
+         * @param noack If True, the payload is written with NO_ACK enabled
+         * @param completion_listener Listener to notify when the transmission has finished, can be nullptr
+         * @return False if another transmission is still in progress
+         */
+        bool send(const uint8_t *data, const uint8_t &size, bool noack = false,
+                  tx_completion_listener *completion_listener = nullptr) {
+            if (busy()) {
+                return false;
+            }
+            nrf.mode_start(nrf.MODE_PTX);
+            nrf.tx_queue_payload(data, size, noack);
+            listener = completion_listener;
+            events.store(0, std::memory_order_relaxed);
+            retries = 0;
+            current = state::settling;
+            deadline = nrf.mode_settled_at;
+            poll();
+            return true;
+        }
+
+        /**
+         * \brief Advance the state machine
+         *
+         * Should be called regularly from the main loop, as long as busy() returns true.
+         * @return The current state
+         */
+        state poll() {
+            uint_fast64_t now = hwlib::now_us();
+            switch (current) {
+                case state::settling:
+                    if (now < deadline) {
+                        break;
+                    }
+                    nrf.pin_write(nrf.ce, true);
+                    current = state::transmitting;
+                    deadline = now + 10;
+                    break;
+
+                case state::transmitting:
+                    if (now < deadline) {
+                        break;
+                    }
+                    nrf.pin_write(nrf.ce, false);
+                    current = state::awaiting_ack;
+                    deadline = now + ack_timeout_us;
+                    check_events(now);
+                    break;
+
+                case state::awaiting_ack:
+                    check_events(now);
+                    break;
+
+                default:
+                    break;
+            }
+            return current;
+        }
+
+        /**
+         * \brief Current state of the transmitter
+         */
+        state get_state() const {
+            return current;
+        }
+
+        /**
+         * \brief Check if a transmission is in progress
+         */
+        bool busy() const {
+            return current == state::settling || current == state::transmitting || current == state::awaiting_ack;
+        }
+
+        /**
+         * \brief Amount of retransmissions the last finished transmission needed
+         */
+        uint8_t last_retries() const {
+            return retries;
+        }
+
+        void tx_sent() override {
+            events.fetch_or(NRF_STATUS::TX_DS, std::memory_order_release);
+        }
+
+        void max_retransmit() override {
+            events.fetch_or(NRF_STATUS::MAX_RT, std::memory_order_release);
+        }
+
+    private:
+        void check_events(uint_fast64_t now) {
+            // The listener methods may run in an interrupt routine, take their flags in one atomic step
+            uint8_t flags = events.exchange(0, std::memory_order_acquire);
+            if (!irq_driven && flags == 0) {
+                nrf.no_operation();
+                flags = nrf.last_status & (NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT);
+                if (flags != 0) {
+                    nrf.write_register(NRF_REGISTER::NRF_STATUS, flags);
+                }
+            }
+
+            if ((flags & NRF_STATUS::MAX_RT) != 0) {
+                nrf.tx_flush();
+                finish(false);
+            } else if ((flags & NRF_STATUS::TX_DS) != 0) {
+                finish(true);
+            } else if (now > deadline) {
+                nrf.tx_flush();
+                finish(false);
+            }
+        }
+
+        void finish(bool success) {
+            retries = nrf.tx_retransmit_count();
+            current = success ? state::done : state::failed;
+            if (listener != nullptr) {
+                listener->tx_complete(success, retries);
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_ASYNC_TX_HPP
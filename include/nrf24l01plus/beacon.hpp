@@ -0,0 +1,159 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_BEACON_HPP
+#define PROJECT_NRF24L01_BEACON_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Sends the same payload on a fixed schedule, using payload reuse
+     *
+     * The payload is written to the TX FIFO once, and marked for reuse (REUSE_TX_PL). After that, every
+     * transmission is a single CE pulse without any SPI traffic. Beacons are sent with NO_ACK, so there is
+     * no MAX_RT to clear; mask TX_DS (nrf24l01plus::interrupt_mask(bool, bool, bool)) if the IRQ pin is used for
+     * something else.
+     *
+     * set_payload() only stores the new content. It is written to the module right before the next beacon:
+     * FLUSH_TX, W_TX_PAYLOAD_NO_ACK and REUSE_TX_PL are issued back to back, after the previous CE pulse and before
+     * the next one. A transmission only starts on a CE pulse, so none can start in between, and a beacon is always
+     * sent either completely old or completely new. The interval needs to be longer than the time on air of a beacon.
+     * The module needs to be powered up, with its TX address set; start() enables the EN_DYN_ACK feature.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class beacon_transmitter {
+        Radio &nrf;
+        uint8_t content[32] = {0};
+        uint8_t size = 0;
+        bool changed = false;
+        bool active = false;
+        uint_fast64_t next_at = 0;
+        uint32_t random_state = 0x2545F491;
+
+    public:
+        //! Time between beacons, in microseconds
+        uint_fast64_t interval_us;
+        //! Random extra time added to every interval, up to this amount of microseconds, to avoid repeated collisions
+        uint_fast64_t jitter_us = 0;
+        //! Amount of beacons sent
+        uint32_t transmissions = 0;
+        //! Amount of times the payload was written to the module
+        uint32_t reloads = 0;
+
+        /**
+         * \brief Create a beacon transmitter, call start() to start sending
+         * @param nrf Module to send on
+         * @param interval_us Time between beacons, in microseconds
+         */
+        beacon_transmitter(Radio &nrf, uint_fast64_t interval_us) : nrf(nrf), interval_us(interval_us) {}
+
+        /**
+         * \brief Set the beacon content, it is used from the next beacon on
+         * @param data The data
+         * @param data_size Size of the data, 1 to 32 bytes
+         * @return False if the size is invalid
+         */
+        bool set_payload(const uint8_t *data, uint8_t data_size) {
+            if (data_size == 0 || data_size > 32) {
+                return false;
+            }
+            for (uint8_t i = 0; i < data_size; i++) {
+                content[i] = data[i];
+            }
+            size = data_size;
+            changed = true;
+            return true;
+        }
+
+        /**
+         * \brief Switch the module to PTX mode, and send the first beacon on the next call to service()
+         *
+         * A payload needs to be set before the first beacon is sent.
+         */
+        void start() {
+            nrf.feature(NRF_FEATURE::EN_DYN_ACK, true);
+            nrf.mode_start(nrf.MODE_PTX);
+            changed = size != 0;
+            next_at = hwlib::now_us();
+            active = true;
+        }
+
+        /**
+         * \brief Stop sending, and take the beacon out of the TX FIFO
+         */
+        void stop() {
+            active = false;
+            nrf.tx_flush();
+        }
+
+        /**
+         * \brief Check if beacons are being sent
+         */
+        bool running() const {
+            return active;
+        }
+
+        /**
+         * \brief Send a beacon if one is due, should be called regularly
+         *
+         * Once the payload is loaded, this doesn't use the SPI bus
+         * @return True if a beacon was sent
+         */
+        bool service() {
+            uint_fast64_t now = hwlib::now_us();
+            if (!active || size == 0 || now < next_at || now < nrf.mode_settled_at) {
+                return false;
+            }
+            if (changed) {
+                load();
+            }
+            nrf.tx_send_payload();
+            transmissions++;
+
+            next_at += interval_us + jitter();
+            if (next_at <= now) {
+                // Fell behind, don't send the missed beacons back to back
+                next_at = now + interval_us;
+            }
+            return true;
+        }
+
+    private:
+        void load() {
+            nrf.tx_flush();
+            nrf.tx_queue_payload(content, size, true);
+            nrf.tx_reuse_payload();
+            changed = false;
+            reloads++;
+        }
+
+        uint_fast64_t jitter() {
+            if (jitter_us == 0) {
+                return 0;
+            }
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 17;
+            random_state ^= random_state << 5;
+            return random_state % (jitter_us + 1);
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_BEACON_HPP
@@ -0,0 +1,318 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_BENCHMARK_HPP
+#define PROJECT_NRF24L01_BENCHMARK_HPP
+
+#include <algorithm>
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief SPI bus wrapper that counts the bytes going through it
+     *
+     * Works with any bus, so the same benchmarks run against simulated_nrf24l01plus and against a real module.
+     */
+    class counting_bus : public spi::spi_base_bus {
+        spi::spi_base_bus &bus;
+
+    public:
+        //! Amount of bytes transferred
+        uint32_t bytes = 0;
+
+        /**
+         * \brief Wrap a bus
+         * @param bus The bus to forward all transfers to
+         */
+        explicit counting_bus(spi::spi_base_bus &bus) : bus(bus) {}
+
+        void write_read(const size_t &n, const uint8_t *data_out, uint8_t *data_in) override {
+            bytes += n;
+            bus.write_read(n, data_out, data_in);
+        }
+
+        void write_read_reverse(const size_t &n, const uint8_t *data_out, uint8_t *data_in) override {
+            bytes += n;
+            bus.write_read_reverse(n, data_out, data_in);
+        }
+    };
+
+    /**
+     * \brief Output pin wrapper that counts falling edges, wrap the CSN pin with it to count SPI transactions
+     */
+    class counting_pin : public hwlib::pin_out {
+        hwlib::pin_out &pin;
+        bool level = true;
+
+    public:
+        //! Amount of high to low transitions
+        uint32_t falling_edges = 0;
+
+        /**
+         * \brief Wrap a pin
+         * @param pin The pin to forward all writes to
+         */
+        explicit counting_pin(hwlib::pin_out &pin) : pin(pin) {}
+
+        void write(bool v) override {
+            if (level && !v) {
+                falling_edges++;
+            }
+            level = v;
+            pin.write(v);
+        }
+
+        void flush() override {
+            pin.flush();
+        }
+    };
+
+    /**
+     * \brief Measurements of one benchmark
+     */
+    struct benchmark_result {
+        //! Name of the benchmark
+        const char *name;
+        //! Amount of iterations
+        uint32_t iterations;
+        //! Payload bytes per iteration, 0 if the benchmark doesn't move payloads
+        uint8_t payload_size;
+        //! Total time spent in the measured code, in microseconds
+        uint64_t elapsed_us;
+        //! SPI transactions during the measured code
+        uint32_t spi_transactions;
+        //! SPI bytes during the measured code
+        uint32_t spi_bytes;
+        //! Latency percentiles, in microseconds
+        uint32_t p50_us, p90_us, p99_us, max_us;
+        //! Iterations that did not complete, for example transmissions that timed out
+        uint32_t failures;
+
+        /**
+         * \brief Print the CSV header matching print()
+         */
+        static void print_header(hwlib::ostream &os) {
+            os << "name,iterations,payload_size,elapsed_us,iterations_per_s,bytes_per_s,"
+                  "spi_transactions_per_iteration,spi_bytes_per_iteration,p50_us,p90_us,p99_us,max_us,failures" << hwlib::endl;
+        }
+
+        /**
+         * \brief Print the result as one CSV line, rates with two decimals
+         */
+        void print(hwlib::ostream &os) const {
+            uint64_t elapsed = elapsed_us == 0 ? 1 : elapsed_us;
+            os << name << ',' << iterations << ',' << unsigned(payload_size) << ',' << (unsigned long long) elapsed_us << ',';
+            print_fixed(os, uint64_t(iterations) * 1000000, elapsed);
+            os << ',';
+            print_fixed(os, uint64_t(iterations) * payload_size * 1000000, elapsed);
+            os << ',';
+            print_fixed(os, spi_transactions, iterations);
+            os << ',';
+            print_fixed(os, spi_bytes, iterations);
+            os << ',' << p50_us << ',' << p90_us << ',' << p99_us << ',' << max_us << ',' << failures << hwlib::endl;
+        }
+
+    private:
+        static void print_fixed(hwlib::ostream &os, uint64_t numerator, uint64_t denominator) {
+            if (denominator == 0) {
+                os << "0.00";
+                return;
+            }
+            uint64_t hundredths = numerator * 100 / denominator;
+            uint8_t fraction = hundredths % 100;
+            os << (unsigned long long) (hundredths / 100) << '.' << char('0' + fraction / 10) << char('0' + fraction % 10);
+        }
+    };
+
+    /**
+     * \brief Runs benchmarks, measuring time, SPI traffic and latency percentiles
+     *
+     * The module under test should be created on the counting_bus and counting_pin (as CSN) given to this harness.
+     * Results are printed as CSV, so runs on different commits or targets can be compared with a script.
+     * @tparam N Amount of latency samples kept, percentiles are taken over the last N iterations
+     */
+    template<size_t N = 256>
+    class benchmark {
+        counting_bus &bus;
+        counting_pin &csn;
+        uint32_t samples[N] = {0};
+
+    public:
+        //! Time to wait for a transmission to finish in tx_write_payload(), in microseconds
+        uint_fast64_t tx_timeout_us = 10000;
+
+        /**
+         * \brief Create a harness
+         * @param bus Bus the module under test uses
+         * @param csn CSN pin the module under test uses
+         */
+        benchmark(counting_bus &bus, counting_pin &csn) : bus(bus), csn(csn) {}
+
+        /**
+         * \brief Run a benchmark
+         * @tparam P Callable without arguments
+         * @tparam F Callable without arguments
+         * @tparam C Callable without arguments, returning bool
+         * @param name Name in the report
+         * @param iterations Amount of times to run body
+         * @param payload_size Payload bytes moved per iteration, for the throughput columns
+         * @param prepare Called before every iteration, not measured
+         * @param body Code to measure
+         * @param complete Called after every iteration, not measured, returns false if the iteration failed
+         * @return The measurements
+         */
+        template<typename P, typename F, typename C>
+        benchmark_result run(const char *name, uint32_t iterations, uint8_t payload_size, P &&prepare, F &&body,
+                             C &&complete) {
+            benchmark_result result = {name, iterations, payload_size, 0, 0, 0, 0, 0, 0, 0, 0};
+            for (uint32_t i = 0; i < iterations; i++) {
+                prepare();
+                uint32_t transactions = csn.falling_edges;
+                uint32_t bytes = bus.bytes;
+                uint_fast64_t start = hwlib::now_us();
+                body();
+                uint32_t duration = hwlib::now_us() - start;
+                result.spi_transactions += csn.falling_edges - transactions;
+                result.spi_bytes += bus.bytes - bytes;
+                result.elapsed_us += duration;
+                samples[i % N] = duration;
+                if (!complete()) {
+                    result.failures++;
+                }
+            }
+
+            size_t count = iterations < N ? iterations : N;
+            if (count > 0) {
+                std::sort(samples, samples + count);
+                result.p50_us = samples[count * 50 / 100];
+                result.p90_us = samples[count * 90 / 100];
+                result.p99_us = samples[count * 99 / 100];
+                result.max_us = samples[count - 1];
+            }
+            return result;
+        }
+
+        /**
+         * \brief Run a benchmark without completion step, see run(const char*, uint32_t, uint8_t, P&&, F&&, C&&)
+         */
+        template<typename P, typename F>
+        benchmark_result run(const char *name, uint32_t iterations, uint8_t payload_size, P &&prepare, F &&body) {
+            return run(name, iterations, payload_size, prepare, body, [] { return true; });
+        }
+
+        /**
+         * \brief Run a benchmark without preparation, see run(const char*, uint32_t, uint8_t, P&&, F&&, C&&)
+         */
+        template<typename F>
+        benchmark_result run(const char *name, uint32_t iterations, uint8_t payload_size, F &&body) {
+            return run(name, iterations, payload_size, [] {}, body);
+        }
+
+        /**
+         * \brief Transmit payloads with NOACK
+         *
+         * Only writing the payload is measured. Waiting for TX_DS happens outside the measured code, so the SPI counts
+         * don't depend on how fast the status register can be polled. A transmission that didn't finish within
+         * tx_timeout_us is flushed and counted as a failure.
+         * Enables the EN_DYN_ACK feature, and switches the module to PTX mode.
+         * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+         */
+        template<typename Radio>
+        benchmark_result tx_write_payload(Radio &nrf, uint32_t iterations, uint8_t size = 32) {
+            uint8_t payload[32] = {0};
+            nrf.feature(NRF_FEATURE::EN_DYN_ACK, true);
+            nrf.mode(nrf.MODE_PTX);
+            return run("tx_write_payload", iterations, size, [] {}, [&] {
+                nrf.tx_write_payload(payload, size, true);
+            }, [&] {
+                uint_fast64_t deadline = hwlib::now_us() + tx_timeout_us;
+                uint8_t flags;
+                do {
+                    nrf.no_operation();
+                    flags = nrf.last_status & (NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT);
+                } while (flags == 0 && hwlib::now_us() < deadline);
+                if (flags == 0) {
+                    nrf.tx_flush();
+                } else {
+                    nrf.write_register(NRF_REGISTER::NRF_STATUS, flags);
+                }
+                return flags == NRF_STATUS::TX_DS;
+            });
+        }
+
+        /**
+         * \brief Read payloads from the RX FIFO
+         * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+         * @tparam P Callable without arguments
+         * @param prepare Called before every iteration, should make sure a payload of size bytes is waiting,
+         * for example by sending one from a second (simulated) module
+         */
+        template<typename Radio, typename P>
+        benchmark_result rx_read_payload(Radio &nrf, uint32_t iterations, uint8_t size, P &&prepare) {
+            uint8_t payload[32];
+            return run("rx_read_payload", iterations, size, prepare, [&] {
+                nrf.rx_read_payload(payload, size);
+            });
+        }
+
+        /**
+         * \brief Switch between PTX and PRX mode, including settling time
+         * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+         */
+        template<typename Radio>
+        benchmark_result mode_switch(Radio &nrf, uint32_t iterations) {
+            uint32_t i = 0;
+            return run("mode_switch", iterations, 0, [&] {
+                nrf.mode(i++ % 2 == 0 ? nrf.MODE_PRX : nrf.MODE_PTX);
+            });
+        }
+
+        /**
+         * \brief Write a typical link configuration: channel, retransmission, rate, power, addresses and payload width
+         * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+         */
+        template<typename Radio>
+        benchmark_result register_configuration(Radio &nrf, uint32_t iterations) {
+            address link(0xE7, 0xE7, 0xE7, 0xE7, 0xE7);
+            return run("register_configuration", iterations, 0, [&] {
+                nrf.channel(76);
+                nrf.auto_retransmit(1, 15);
+                nrf.data_rate(NRF_DATA_RATE::RATE_2MBPS);
+                nrf.tx_power(NRF_TX_POWER::POWER_0DBM);
+                nrf.tx_set_address(link);
+                nrf.rx_set_address(0, link);
+                nrf.rx_set_payload_width(0, 32);
+            });
+        }
+    };
+
+    /**
+     * \brief Print benchmark results as CSV, with a header line
+     * @param os Stream to print to
+     * @param results The results
+     * @param count Amount of results
+     */
+    inline void write_report(hwlib::ostream &os, const benchmark_result *results, size_t count) {
+        benchmark_result::print_header(os);
+        for (size_t i = 0; i < count; i++) {
+            results[i].print(os);
+        }
+    }
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_BENCHMARK_HPP
@@ -0,0 +1,180 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_CHANNEL_SCANNER_HPP
+#define PROJECT_NRF24L01_CHANNEL_SCANNER_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Spectrum scanner based on the Received Power Detector
+     *
+     * Sweeps channels in PRX mode and counts how often RPD reports a carrier on each of them.
+     * Every sample costs one channel hop (RF_CH write) and one RPD read, and hops only wait for the receiver to settle,
+     * so a sweep can be repeated during operation. Samples of one channel are spread over separate passes,
+     * which catches bursty interference (like Wi-Fi) better than sampling one channel several times in a row.
+     * Samples are counted per channel, so sweeps over different ranges can be mixed; channels are compared by their
+     * share of hits, and channels that were never sampled rank last.
+     * The module needs to be powered up.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class channel_scanner {
+    public:
+        //! Amount of channels the NRF24L01+ supports
+        static constexpr const uint8_t CHANNELS = 126;
+
+        //! Amount of samples that detected a carrier, per channel
+        uint16_t hits[CHANNELS] = {0};
+        //! Amount of samples taken, per channel
+        uint16_t samples[CHANNELS] = {0};
+
+    private:
+        Radio &nrf;
+        uint16_t settle_us;
+
+    public:
+        /**
+         * \brief Create a channel scanner
+         * @param nrf Module to scan with
+         * @param settle_us Time to wait after each hop before reading RPD, 170μs according to the datasheet
+         */
+        explicit channel_scanner(Radio &nrf, uint16_t settle_us = 170) : nrf(nrf), settle_us(settle_us) {}
+
+        /**
+         * \brief Clear the histogram
+         */
+        void reset() {
+            for (uint8_t channel = 0; channel < CHANNELS; channel++) {
+                hits[channel] = 0;
+                samples[channel] = 0;
+            }
+        }
+
+        /**
+         * \brief Sample a range of channels, adding to the histogram
+         *
+         * The module's mode and channel are restored afterwards.
+         * @param passes Amount of samples to take of each channel
+         * @param first First channel to scan
+         * @param last Last channel to scan
+         */
+        void sweep(uint8_t passes = 8, uint8_t first = 0, uint8_t last = CHANNELS - 1) {
+            uint8_t previous_mode = nrf.get_mode();
+            uint8_t previous_channel;
+            nrf.read_register(NRF_REGISTER::RF_CH, &previous_channel);
+            nrf.mode(nrf.MODE_PRX);
+
+            for (uint8_t pass = 0; pass < passes; pass++) {
+                for (uint8_t channel = first; channel <= last && channel < CHANNELS; channel++) {
+                    nrf.pin_write(nrf.ce, false);
+                    nrf.channel(channel);
+                    nrf.pin_write(nrf.ce, true);
+                    hwlib::wait_us(settle_us);
+                    if (samples[channel] == UINT16_MAX) {
+                        continue;
+                    }
+                    samples[channel]++;
+                    if (nrf.received_power_detector()) {
+                        hits[channel]++;
+                    }
+                }
+            }
+
+            nrf.pin_write(nrf.ce, false);
+            nrf.channel(previous_channel);
+            nrf.pin_write(nrf.ce, true);
+            nrf.mode(previous_mode);
+        }
+
+        /**
+         * \brief Occupancy of a channel
+         * @param channel The channel
+         * @return Percentage of samples that detected a carrier
+         */
+        uint8_t occupancy(uint8_t channel) const {
+            if (channel >= CHANNELS || samples[channel] == 0) {
+                return 0;
+            }
+            return uint32_t(hits[channel]) * 100 / samples[channel];
+        }
+
+        /**
+         * \brief Check if a channel had a smaller share of hits than another one
+         *
+         * A channel without samples is never quieter than a channel with samples.
+         */
+        bool quieter(uint8_t channel, uint8_t other) const {
+            if (samples[channel] == 0 || samples[other] == 0) {
+                return samples[other] == 0 && samples[channel] != 0;
+            }
+            return uint32_t(hits[channel]) * samples[other] < uint32_t(hits[other]) * samples[channel];
+        }
+
+        /**
+         * \brief Find the quietest channel in a range
+         *
+         * On a tie, the lowest channel wins.
+         * @param first First channel to consider
+         * @param last Last channel to consider
+         * @return The channel with the smallest share of hits
+         */
+        uint8_t quietest(uint8_t first = 0, uint8_t last = CHANNELS - 1) const {
+            uint8_t best = first;
+            for (uint8_t channel = first; channel <= last && channel < CHANNELS; channel++) {
+                if (quieter(channel, best)) {
+                    best = channel;
+                }
+            }
+            return best;
+        }
+
+        /**
+         * \brief Rank the quietest channels
+         *
+         * @param channels Memory location to store the ranked channels in, quietest first
+         * @param n Amount of channels to rank
+         * @return Amount of channels stored (at most CHANNELS)
+         */
+        uint8_t rank(uint8_t *channels, uint8_t n) const {
+            if (n > CHANNELS) {
+                n = CHANNELS;
+            }
+            uint8_t count = 0;
+            for (uint8_t channel = 0; channel < CHANNELS; channel++) {
+                uint8_t position = count;
+                while (position > 0 && quieter(channel, channels[position - 1])) {
+                    if (position < n) {
+                        channels[position] = channels[position - 1];
+                    }
+                    position--;
+                }
+                if (position < n) {
+                    channels[position] = channel;
+                    if (count < n) {
+                        count++;
+                    }
+                }
+            }
+            return count;
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_CHANNEL_SCANNER_HPP
@@ -0,0 +1,355 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_CONFIG_HPP
+#define PROJECT_NRF24L01_CONFIG_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Configuration of a single RX pipe
+     */
+    struct pipe_config {
+        //! Pipe is enabled (EN_RXADDR)
+        bool enabled = false;
+        //! Auto Acknowledgement is enabled (EN_AA)
+        bool auto_ack = true;
+        //! Dynamic Payload Length is enabled (DYNPD)
+        bool dynamic_payload_length = false;
+        //! Static payload width (RX_PW_Px), ignored with Dynamic Payload Length
+        uint8_t payload_width = 0;
+        //! Pipe address, in the same byte order as nrf24l01::address. Pipes 2-5 only use the last byte
+        uint8_t address[5] = {0, 0, 0, 0, 0};
+    };
+
+    /**
+     * \brief Complete radio configuration, meant to be created and validated at compile time
+     *
+     * A configuration is best made in a constexpr function, starting from the defaults:
+     *
+     *     constexpr radio_config make_sensor_config() {
+     *         radio_config config;
+     *         config.channel = 76;
+     *         config.pipes[1].enabled = true;
+     *         config.pipes[1].payload_width = 8;
+     *         return config;
+     *     }
+     *     static constexpr radio_config sensor_config = make_sensor_config();
+     *
+     * The defaults are the power on reset values of the NRF24L01+, except that all pipes start disabled.
+     */
+    struct radio_config {
+        //! RF channel (RF_CH), 0-125
+        uint8_t channel = 2;
+        //! Auto retransmit delay, in steps of 250μs (SETUP_RETR), 0-15
+        uint8_t retry_delay = 0;
+        //! Auto retransmit count (SETUP_RETR), 0-15
+        uint8_t retry_count = 3;
+        //! RF setup register value (data rate and output power, see NRF_RF_SETUP)
+        uint8_t rf_setup = 0x0E;
+        //! Address width in bytes (SETUP_AW), 3-5
+        uint8_t address_width = 5;
+        //! Enable CRC
+        bool crc = true;
+        //! Use a 2 byte CRC instead of 1 byte
+        bool crc_2_bytes = false;
+        //! Power the module up
+        bool power_up = true;
+        //! Reflect RX_DR on the IRQ pin
+        bool interrupt_rx_ready = true;
+        //! Reflect TX_DS on the IRQ pin
+        bool interrupt_tx_sent = true;
+        //! Reflect MAX_RT on the IRQ pin
+        bool interrupt_max_retransmit = true;
+        //! Enabled features (see NRF_FEATURE)
+        uint8_t features = 0;
+        //! Address to transmit to, in the same byte order as nrf24l01::address
+        uint8_t tx_address[5] = {0xE7, 0xE7, 0xE7, 0xE7, 0xE7};
+        //! Configuration of the RX pipes
+        pipe_config pipes[6] = {};
+
+        /**
+         * \brief Check that the channel is in range
+         */
+        constexpr bool valid_channel() const {
+            return channel <= 125;
+        }
+
+        /**
+         * \brief Check the retransmit settings fit in SETUP_RETR
+         */
+        constexpr bool valid_retransmit() const {
+            return retry_delay <= 15 && retry_count <= 15;
+        }
+
+        /**
+         * \brief Check the address width is 3, 4 or 5 bytes
+         */
+        constexpr bool valid_address_width() const {
+            return address_width >= 3 && address_width <= 5;
+        }
+
+        /**
+         * \brief Check that 250kbps and 2Mbps are not selected at the same time
+         */
+        constexpr bool valid_data_rate() const {
+            return (rf_setup & NRF_RF_SETUP::RF_DR_LOW) == 0 || (rf_setup & NRF_RF_SETUP::RF_DR_HIGH) == 0;
+        }
+
+        /**
+         * \brief Check all static payload widths are at most 32 bytes
+         */
+        constexpr bool valid_payload_widths() const {
+            for (const auto &pipe : pipes) {
+                if (pipe.payload_width > 32) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * \brief Check Dynamic Payload Length is only used with the EN_DPL feature and Auto Acknowledgement
+         */
+        constexpr bool valid_dynamic_payload_length() const {
+            for (const auto &pipe : pipes) {
+                if (pipe.dynamic_payload_length &&
+                    ((features & NRF_FEATURE::EN_DPL) == 0 || !pipe.auto_ack)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * \brief Check ACK payloads are only used together with Dynamic Payload Length
+         */
+        constexpr bool valid_ack_payload() const {
+            return (features & NRF_FEATURE::EN_ACK_PAY) == 0 || (features & NRF_FEATURE::EN_DPL) != 0;
+        }
+
+        /**
+         * \brief Check CRC is enabled when any pipe uses Auto Acknowledgement, which forces CRC on
+         */
+        constexpr bool valid_crc() const {
+            for (const auto &pipe : pipes) {
+                if (pipe.auto_ack && !crc) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * \brief Check every rule at once
+         */
+        constexpr bool valid() const {
+            return valid_channel() && valid_retransmit() && valid_address_width() && valid_data_rate() &&
+                   valid_payload_widths() && valid_dynamic_payload_length() && valid_ack_payload() && valid_crc();
+        }
+    };
+
+    /**
+     * \brief A single register write, with the data in the byte order it is sent over SPI
+     */
+    struct register_write {
+        //! Register address
+        uint8_t address = 0;
+        //! Register data
+        uint8_t data[5] = {0, 0, 0, 0, 0};
+    };
+
+    /**
+     * \brief Ordered list of register writes, produced by compile_config(const radio_config&, bool)
+     */
+    struct register_sequence {
+        //! Largest amount of writes a configuration can produce
+        static constexpr const size_t MAX_WRITES = 23;
+        //! The writes, in order
+        register_write writes[MAX_WRITES] = {};
+        //! Amount of writes
+        size_t count = 0;
+
+        /**
+         * \brief Add a write of a single byte register
+         */
+        constexpr void add(uint8_t address, uint8_t value) {
+            writes[count].address = address;
+            writes[count].data[0] = value;
+            count++;
+        }
+
+        /**
+         * \brief Add a write of an address register, reversing the bytes so the LSByte goes first
+         */
+        constexpr void add(uint8_t address, const uint8_t (&value)[5]) {
+            writes[count].address = address;
+            for (uint8_t i = 0; i < 5; i++) {
+                writes[count].data[i] = value[4 - i];
+            }
+            count++;
+        }
+    };
+
+    /**
+     * \brief Turn a configuration into the register writes that apply it
+     *
+     * Writes are ordered so that FEATURE comes before DYNPD, and CONFIG (which may power the module up) comes last.
+     * Only enabled pipes get their address and payload width written.
+     * @param config The configuration
+     * @param from_reset If True, registers that keep their power on reset value are left out
+     * @return The register writes
+     */
+    constexpr register_sequence compile_config(const radio_config &config, bool from_reset = false) {
+        register_sequence sequence;
+        uint8_t en_aa = 0, en_rxaddr = 0, dynpd = 0;
+        for (uint8_t i = 0; i < 6; i++) {
+            en_aa |= config.pipes[i].auto_ack ? 1u << i : 0u;
+            en_rxaddr |= config.pipes[i].enabled ? 1u << i : 0u;
+            dynpd |= config.pipes[i].dynamic_payload_length ? 1u << i : 0u;
+        }
+
+        uint8_t setup_aw = config.address_width - 2;
+        uint8_t setup_retr = config.retry_delay << 4 | config.retry_count;
+        if (!from_reset || en_aa != 0x3F) {
+            sequence.add(NRF_REGISTER::EN_AA, en_aa);
+        }
+        if (!from_reset || en_rxaddr != 0x03) {
+            sequence.add(NRF_REGISTER::EN_RXADDR, en_rxaddr);
+        }
+        if (!from_reset || setup_aw != 0x03) {
+            sequence.add(NRF_REGISTER::SETUP_AW, setup_aw);
+        }
+        if (!from_reset || setup_retr != 0x03) {
+            sequence.add(NRF_REGISTER::SETUP_RETR, setup_retr);
+        }
+        if (!from_reset || config.channel != 0x02) {
+            sequence.add(NRF_REGISTER::RF_CH, config.channel);
+        }
+        if (!from_reset || config.rf_setup != 0x0E) {
+            sequence.add(NRF_REGISTER::RF_SETUP, config.rf_setup);
+        }
+
+        const uint8_t reset_lsbyte[6] = {0xE7, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6};
+        for (uint8_t i = 0; i < 6; i++) {
+            const pipe_config &pipe = config.pipes[i];
+            if (!pipe.enabled) {
+                continue;
+            }
+            bool is_reset = pipe.address[4] == reset_lsbyte[i];
+            if (i < 2) {
+                for (uint8_t j = 0; j < 4; j++) {
+                    is_reset &= pipe.address[j] == reset_lsbyte[i];
+                }
+            }
+            if (!from_reset || !is_reset) {
+                if (i < 2) {
+                    sequence.add(NRF_REGISTER::RX_ADDR_P0 + i, pipe.address);
+                } else {
+                    sequence.add(NRF_REGISTER::RX_ADDR_P0 + i, pipe.address[4]);
+                }
+            }
+        }
+
+        bool tx_is_reset = true;
+        for (uint8_t j = 0; j < 5; j++) {
+            tx_is_reset &= config.tx_address[j] == 0xE7;
+        }
+        if (!from_reset || !tx_is_reset) {
+            sequence.add(NRF_REGISTER::TX_ADDR, config.tx_address);
+        }
+
+        for (uint8_t i = 0; i < 6; i++) {
+            const pipe_config &pipe = config.pipes[i];
+            if (pipe.enabled && !pipe.dynamic_payload_length && (!from_reset || pipe.payload_width != 0)) {
+                sequence.add(NRF_REGISTER::RX_PW_P0 + i, pipe.payload_width);
+            }
+        }
+
+        if (!from_reset || config.features != 0) {
+            sequence.add(NRF_REGISTER::FEATURE, config.features);
+        }
+        if (!from_reset || dynpd != 0) {
+            sequence.add(NRF_REGISTER::DYNPD, dynpd);
+        }
+
+        uint8_t config_register = (config.crc ? NRF_CONFIG::CONFIG_EN_CRC : 0) |
+                                  (config.crc_2_bytes ? NRF_CONFIG::CONFIG_CRCO : 0) |
+                                  (config.power_up ? NRF_CONFIG::CONFIG_PWR_UP : 0) |
+                                  (config.interrupt_rx_ready ? 0 : NRF_CONFIG::MASK_RX) |
+                                  (config.interrupt_tx_sent ? 0 : NRF_CONFIG::MASK_TX_DS) |
+                                  (config.interrupt_max_retransmit ? 0 : NRF_CONFIG::MASK_MAX_RT);
+        if (!from_reset || config_register != 0x08) {
+            sequence.add(NRF_REGISTER::CONFIG, config_register);
+        }
+        return sequence;
+    }
+
+    /**
+     * \brief Apply a list of register writes in one pass, without reading anything
+     *
+     * The module is put in MODE_NONE first, so the configuration is applied in Standby or Power Down mode.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     * @param nrf Module to configure
+     * @param sequence The register writes
+     */
+    template<typename Radio>
+    void apply_register_sequence(Radio &nrf, const register_sequence &sequence) {
+        nrf.mode(nrf.MODE_NONE);
+        for (size_t i = 0; i < sequence.count; i++) {
+            nrf.write_register(sequence.writes[i].address, sequence.writes[i].data);
+        }
+    }
+
+    /**
+     * \brief Radio profile, validated and compiled at compile time
+     *
+     * Usage: `radio_profile<sensor_config>::apply(nrf);`, where sensor_config is a radio_config with static storage duration.
+     * Any invalid setting results in a compile error naming the rule that was broken.
+     * @tparam config The configuration
+     * @tparam from_reset If True, the module is assumed to hold its power on reset values, and these are not rewritten
+     */
+    template<const radio_config &config, bool from_reset = false>
+    struct radio_profile {
+        static_assert(config.valid_channel(), "Channel must be in range 0-125");
+        static_assert(config.valid_retransmit(), "Retry delay and retry count must be in range 0-15");
+        static_assert(config.valid_address_width(), "Address width must be 3, 4 or 5 bytes");
+        static_assert(config.valid_data_rate(), "RF_DR_LOW and RF_DR_HIGH can't be set at the same time");
+        static_assert(config.valid_payload_widths(), "Payload widths must be at most 32 bytes");
+        static_assert(config.valid_dynamic_payload_length(),
+                      "Dynamic Payload Length needs the EN_DPL feature and Auto Acknowledgement on its pipe");
+        static_assert(config.valid_ack_payload(), "ACK payloads need the EN_DPL feature");
+        static_assert(config.valid_crc(), "Auto Acknowledgement forces CRC, so CRC must be enabled");
+
+        //! The register writes for this profile
+        static constexpr register_sequence sequence = compile_config(config, from_reset);
+
+        /**
+         * \brief Apply this profile to a module
+         * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+         * @param nrf Module to configure
+         */
+        template<typename Radio>
+        static void apply(Radio &nrf) {
+            apply_register_sequence(nrf, sequence);
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_CONFIG_HPP
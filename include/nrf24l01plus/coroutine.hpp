@@ -0,0 +1,602 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_COROUTINE_HPP
+#define PROJECT_NRF24L01_COROUTINE_HPP
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "nrf24l01plus/coroutine.hpp needs C++20 coroutines, compile with -std=c++20 (and -fcoroutines on GCC 10)"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <nrf24l01plus/nrf24l01plus.hpp>
+#include <nrf24l01plus/packet_pool.hpp>
+
+//! Size in bytes of one coroutine frame in the frame pool
+#ifndef NRF24L01_COROUTINE_FRAME_SIZE
+#define NRF24L01_COROUTINE_FRAME_SIZE 256
+#endif
+
+//! Amount of coroutine frames in the frame pool, at most 32
+#ifndef NRF24L01_COROUTINE_FRAMES
+#define NRF24L01_COROUTINE_FRAMES 8
+#endif
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Statically allocated storage for the frames of radio_task coroutines
+     *
+     * Frame size and count are set with NRF24L01_COROUTINE_FRAME_SIZE and NRF24L01_COROUTINE_FRAMES.
+     * A coroutine whose frame doesn't fit, or that is started while all frames are in use, is not started
+     * (see radio_task::valid()).
+     */
+    class coroutine_frame_pool {
+    public:
+        //! Size in bytes of one frame
+        static constexpr const size_t FRAME_SIZE = NRF24L01_COROUTINE_FRAME_SIZE;
+        //! Amount of frames
+        static constexpr const size_t FRAMES = NRF24L01_COROUTINE_FRAMES;
+        static_assert(FRAMES > 0 && FRAMES <= 32, "The coroutine frame pool holds 1 to 32 frames");
+
+    private:
+        alignas(std::max_align_t) static inline uint8_t storage[FRAMES][FRAME_SIZE];
+        static inline uint32_t used = 0;
+
+    public:
+        /**
+         * \brief Take a frame
+         * @param size Size the coroutine needs
+         * @return The frame, or nullptr if size is too large or all frames are in use
+         */
+        static void *allocate(size_t size) noexcept {
+            if (size > FRAME_SIZE) {
+                return nullptr;
+            }
+            for (size_t i = 0; i < FRAMES; i++) {
+                if ((used & (1ul << i)) == 0) {
+                    used |= 1ul << i;
+                    return storage[i];
+                }
+            }
+            return nullptr;
+        }
+
+        /**
+         * \brief Give a frame back
+         */
+        static void release(void *frame) noexcept {
+            size_t index = (static_cast<uint8_t *>(frame) - storage[0]) / FRAME_SIZE;
+            used &= ~(1ul << index);
+        }
+
+        /**
+         * \brief Amount of free frames
+         */
+        static size_t available() {
+            size_t count = 0;
+            for (size_t i = 0; i < FRAMES; i++) {
+                count += (used & (1ul << i)) == 0;
+            }
+            return count;
+        }
+    };
+
+    /**
+     * \brief Operation a radio_task is suspended on, that has to be unlinked when the task is destroyed
+     */
+    class coroutine_waiter {
+    public:
+        /**
+         * \brief Stop waiting, the coroutine will not be resumed for this operation anymore
+         */
+        virtual void cancel() = 0;
+    };
+
+    /**
+     * \brief Coroutine running radio operations, for example a conversation with one peer
+     *
+     * The coroutine starts running immediately, until its first co_await. Its frame comes from the
+     * coroutine_frame_pool, and is released when the task object is destroyed. Destroying the task while the
+     * coroutine waits for a coroutine_radio cancels the operation it waits for, including a transmission in progress.
+     */
+    class radio_task {
+    public:
+        /**
+         * \brief Promise type, used by the compiler
+         */
+        struct promise_type {
+            //! Operation the coroutine is suspended on, nullptr while it runs
+            coroutine_waiter *waiting = nullptr;
+
+            radio_task get_return_object() {
+                return radio_task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            static radio_task get_return_object_on_allocation_failure() {
+                return radio_task(nullptr);
+            }
+
+            std::suspend_never initial_suspend() noexcept {
+                return {};
+            }
+
+            std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+
+            void return_void() {}
+
+            void unhandled_exception() {
+                std::terminate();
+            }
+
+            static void *operator new(size_t size) noexcept {
+                return coroutine_frame_pool::allocate(size);
+            }
+
+            static void operator delete(void *frame) noexcept {
+                coroutine_frame_pool::release(frame);
+            }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+
+        explicit radio_task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    public:
+        radio_task(radio_task &&other) noexcept : handle(other.handle) {
+            other.handle = nullptr;
+        }
+
+        radio_task &operator=(radio_task &&other) noexcept {
+            if (this != &other) {
+                destroy();
+                handle = other.handle;
+                other.handle = nullptr;
+            }
+            return *this;
+        }
+
+        radio_task(const radio_task &) = delete;
+
+        radio_task &operator=(const radio_task &) = delete;
+
+        ~radio_task() {
+            destroy();
+        }
+
+        /**
+         * \brief Check if the coroutine got a frame, and was started
+         */
+        bool valid() const {
+            return bool(handle);
+        }
+
+        /**
+         * \brief Check if the coroutine has finished, or was never started
+         */
+        bool done() const {
+            return !handle || handle.done();
+        }
+
+    private:
+        void destroy() {
+            if (handle) {
+                if (!handle.done() && handle.promise().waiting != nullptr) {
+                    handle.promise().waiting->cancel();
+                }
+                handle.destroy();
+                handle = nullptr;
+            }
+        }
+    };
+
+    /**
+     * \brief Awaitable operations on a module, for coroutines
+     *
+     * Usage, from a radio_task:
+     *  - `bool acknowledged = co_await radio.send(data, size);`
+     *  - `packet p; bool received = co_await radio.receive(p, timeout_us);`
+     *  - `co_await radio.mode_ready();` or `co_await radio.delay(us);`
+     *
+     * Waiting coroutines are resumed from poll(), when TX_DS, MAX_RT or RX_DR fire or a deadline passes,
+     * so poll() should be called from the main loop. With an IRQ pin, the status register is only read when
+     * the pin is low or irq_pending() was called from the interrupt routine.
+     * Transmissions from different coroutines are sent one at a time, in the order they were started.
+     * The module returns to PRX mode when nothing is being sent.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class coroutine_radio {
+        struct waiter : coroutine_waiter {
+            //! Radio whose poll() resumes the coroutine
+            coroutine_radio &radio;
+            std::coroutine_handle<> handle;
+            waiter *next = nullptr;
+            uint_fast64_t deadline = 0;
+            bool result = false;
+            coroutine_waiter **owner = nullptr;
+
+            explicit waiter(coroutine_radio &radio) : radio(radio) {}
+
+            void cancel() override {
+                radio.cancel(this);
+            }
+
+            /**
+             * \brief Remember the suspended coroutine, and register with its radio_task so destroying it cancels this
+             */
+            template<typename Promise>
+            void suspend(std::coroutine_handle<Promise> h) {
+                handle = h;
+                if constexpr (std::is_same_v<Promise, radio_task::promise_type>) {
+                    owner = &h.promise().waiting;
+                    *owner = this;
+                }
+            }
+
+            void resumed() {
+                if (owner != nullptr) {
+                    *owner = nullptr;
+                    owner = nullptr;
+                }
+            }
+        };
+
+        struct waiter_list {
+            waiter *head = nullptr;
+            waiter *tail = nullptr;
+
+            void push(waiter *w) {
+                w->next = nullptr;
+                if (tail == nullptr) {
+                    head = w;
+                } else {
+                    tail->next = w;
+                }
+                tail = w;
+            }
+
+            waiter *pop() {
+                waiter *w = head;
+                if (w != nullptr) {
+                    head = w->next;
+                    if (head == nullptr) {
+                        tail = nullptr;
+                    }
+                }
+                return w;
+            }
+
+            void remove(waiter *w) {
+                waiter *previous = nullptr;
+                for (waiter *current = head; current != nullptr; previous = current, current = current->next) {
+                    if (current != w) {
+                        continue;
+                    }
+                    (previous == nullptr ? head : previous->next) = current->next;
+                    if (tail == current) {
+                        tail = previous;
+                    }
+                    return;
+                }
+            }
+
+            bool empty() const {
+                return head == nullptr;
+            }
+        };
+
+    public:
+        /**
+         * \brief Awaitable transmission, see send()
+         */
+        struct send_operation : waiter {
+            //! Data to send
+            const uint8_t *data;
+            //! Size of the data
+            uint8_t size;
+            //! Send without acknowledgement
+            bool noack;
+
+            send_operation(coroutine_radio &radio, const uint8_t *data, uint8_t size, bool noack) :
+                    waiter(radio), data(data), size(size), noack(noack) {}
+
+            bool await_ready() {
+                return false;
+            }
+
+            template<typename Promise>
+            void await_suspend(std::coroutine_handle<Promise> h) {
+                this->suspend(h);
+                this->radio.tx_waiting.push(this);
+                this->radio.start_transmission(hwlib::now_us());
+            }
+
+            bool await_resume() {
+                this->resumed();
+                return this->result;
+            }
+        };
+
+        /**
+         * \brief Awaitable reception, see receive()
+         */
+        struct receive_operation : waiter {
+            //! Packet to copy the payload into
+            packet &out;
+            //! Time to wait, 0 to wait forever
+            uint_fast64_t timeout_us;
+
+            receive_operation(coroutine_radio &radio, packet &out, uint_fast64_t timeout_us) :
+                    waiter(radio), out(out), timeout_us(timeout_us) {}
+
+            bool await_ready() {
+                this->result = this->radio.inbound.pop(out);
+                return this->result;
+            }
+
+            template<typename Promise>
+            void await_suspend(std::coroutine_handle<Promise> h) {
+                this->suspend(h);
+                this->deadline = timeout_us == 0 ? UINT64_MAX : hwlib::now_us() + timeout_us;
+                this->radio.rx_waiting.push(this);
+                this->radio.listen();
+            }
+
+            bool await_resume() {
+                this->resumed();
+                return this->result;
+            }
+        };
+
+        /**
+         * \brief Awaitable deadline, see delay() and mode_ready()
+         */
+        struct delay_operation : waiter {
+            delay_operation(coroutine_radio &radio, uint_fast64_t until) : waiter(radio) {
+                this->deadline = until;
+            }
+
+            bool await_ready() {
+                return hwlib::now_us() >= this->deadline;
+            }
+
+            template<typename Promise>
+            void await_suspend(std::coroutine_handle<Promise> h) {
+                this->suspend(h);
+                this->radio.timers.push(this);
+            }
+
+            void await_resume() {
+                this->resumed();
+            }
+        };
+
+        //! Time to wait for TX_DS or MAX_RT before giving up, in microseconds
+        uint_fast64_t ack_timeout_us = 100000;
+        //! Received payloads that were dropped because no coroutine picked them up in time
+        uint32_t dropped = 0;
+
+    private:
+        Radio &nrf;
+        hwlib::pin_in *irq;
+        std::atomic<bool> irq_flag{false};
+        waiter_list tx_waiting;
+        waiter_list rx_waiting;
+        waiter_list timers;
+        waiter_list ready;
+        send_operation *sending = nullptr;
+        bool payload_written = false;
+        uint_fast64_t tx_deadline = 0;
+        spsc_ring<packet, 4> inbound;
+
+    public:
+        /**
+         * \brief Create a coroutine interface for a module
+         * @param nrf The module, powered up and configured
+         * @param irq The (active low) IRQ pin of the module, or nullptr to read the status register on every poll()
+         * while a coroutine waits for the module
+         */
+        explicit coroutine_radio(Radio &nrf, hwlib::pin_in *irq = nullptr) : nrf(nrf), irq(irq) {}
+
+        coroutine_radio(const coroutine_radio &) = delete;
+
+        coroutine_radio &operator=(const coroutine_radio &) = delete;
+
+        /**
+         * \brief Send a payload, the result of co_await is true if it was sent (and acknowledged)
+         *
+         * The data needs to stay valid until the operation is resumed.
+         * For using NOACK, the feature needs to be enabled in the FEATURE register
+         */
+        send_operation send(const uint8_t *data, uint8_t size, bool noack = false) {
+            return {*this, data, size, noack};
+        }
+
+        /**
+         * \brief Receive a payload, the result of co_await is false if the timeout passed first
+         * @param out Packet to copy the payload into
+         * @param timeout_us Time to wait, 0 to wait forever
+         */
+        receive_operation receive(packet &out, uint_fast64_t timeout_us = 0) {
+            return {*this, out, timeout_us};
+        }
+
+        /**
+         * \brief Wait until the module has settled in its current mode
+         */
+        delay_operation mode_ready() {
+            return {*this, nrf.mode_settled_at};
+        }
+
+        /**
+         * \brief Wait for a while, without blocking the other coroutines
+         */
+        delay_operation delay(uint_fast64_t us) {
+            return {*this, hwlib::now_us() + us};
+        }
+
+        /**
+         * \brief Mark the IRQ pin as asserted, safe to call from an interrupt routine
+         */
+        void irq_pending() {
+            irq_flag.store(true, std::memory_order_release);
+        }
+
+        /**
+         * \brief Handle module events and deadlines, and resume the coroutines that can continue
+         *
+         * Should be called regularly from the main loop.
+         * @return Amount of coroutines resumed
+         */
+        uint8_t poll() {
+            uint_fast64_t now = hwlib::now_us();
+            if (sending != nullptr || !rx_waiting.empty() || irq != nullptr) {
+                if (irq_asserted()) {
+                    handle_events(now);
+                }
+            }
+
+            if (sending != nullptr && payload_written && now > tx_deadline) {
+                nrf.tx_flush();
+                finish_transmission(false);
+            }
+            start_transmission(now);
+            expire(rx_waiting, now);
+            expire(timers, now);
+
+            uint8_t resumed = 0;
+            while (waiter *w = ready.pop()) {
+                w->handle.resume();
+                resumed++;
+            }
+            return resumed;
+        }
+
+    private:
+        bool irq_asserted() {
+            if (irq_flag.exchange(false, std::memory_order_acquire)) {
+                return true;
+            }
+            if (irq == nullptr) {
+                return true;
+            }
+            irq->refresh();
+            return !irq->read();
+        }
+
+        void handle_events(uint_fast64_t now) {
+            uint8_t flags = nrf.clear_interrupts();
+            if (sending != nullptr && payload_written) {
+                if ((flags & NRF_STATUS::MAX_RT) != 0) {
+                    nrf.tx_flush();
+                    finish_transmission(false);
+                } else if ((flags & NRF_STATUS::TX_DS) != 0) {
+                    finish_transmission(true);
+                }
+            }
+            if ((flags & NRF_STATUS::RX_DR) != 0) {
+                nrf.rx_drain([&](uint8_t pipe, const uint8_t *data, uint8_t width) {
+                    packet received = {};
+                    for (uint8_t i = 0; i < width; i++) {
+                        received.data[i] = data[i];
+                    }
+                    received.pipe = pipe;
+                    received.length = width;
+                    received.timestamp = static_cast<uint32_t>(now);
+                    if (!inbound.push(received)) {
+                        dropped++;
+                    }
+                });
+            }
+            // Hand payloads to the coroutines in the order they started waiting
+            while (!rx_waiting.empty() && !inbound.empty()) {
+                auto *w = static_cast<receive_operation *>(rx_waiting.pop());
+                inbound.pop(w->out);
+                w->result = true;
+                ready.push(w);
+            }
+        }
+
+        void start_transmission(uint_fast64_t now) {
+            if (sending == nullptr) {
+                sending = static_cast<send_operation *>(tx_waiting.pop());
+                payload_written = false;
+                if (sending == nullptr) {
+                    listen();
+                    return;
+                }
+                nrf.mode_start(nrf.MODE_PTX);
+            }
+            if (payload_written || now < nrf.mode_settled_at) {
+                return;
+            }
+            nrf.tx_write_payload(sending->data, sending->size, sending->noack);
+            payload_written = true;
+            tx_deadline = now + ack_timeout_us;
+        }
+
+        void finish_transmission(bool success) {
+            sending->result = success;
+            ready.push(sending);
+            sending = nullptr;
+        }
+
+        void listen() {
+            if (sending == nullptr && tx_waiting.empty()) {
+                nrf.mode_start(nrf.MODE_PRX);
+            }
+        }
+
+        void cancel(waiter *w) {
+            tx_waiting.remove(w);
+            rx_waiting.remove(w);
+            timers.remove(w);
+            ready.remove(w);
+            if (sending == w) {
+                // The payload may be in the TX FIFO already, and its data goes away with the coroutine frame.
+                // Its TX_DS or MAX_RT must not finish the next transmission.
+                nrf.tx_flush();
+                nrf.write_register(NRF_REGISTER::NRF_STATUS, uint8_t(NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT));
+                sending = nullptr;
+                payload_written = false;
+            }
+        }
+
+        void expire(waiter_list &list, uint_fast64_t now) {
+            waiter *w = list.head;
+            while (w != nullptr) {
+                waiter *next = w->next;
+                if (now >= w->deadline) {
+                    list.remove(w);
+                    w->result = false;
+                    ready.push(w);
+                }
+                w = next;
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_COROUTINE_HPP
@@ -150,6 +150,32 @@ namespace nrf24l01 {
         static constexpr const uint8_t RF_PWR = 6;
     };
 
+    /**
+     * \brief Data rate settings, as RF_DR_LOW and RF_DR_HIGH bits in the RF_SETUP register
+     */
+    struct NRF_DATA_RATE {
+        //! 1 Mbps
+        static constexpr const uint8_t RATE_1MBPS = 0x00;
+        //! 2 Mbps
+        static constexpr const uint8_t RATE_2MBPS = NRF_RF_SETUP::RF_DR_HIGH;
+        //! 250 kbps
+        static constexpr const uint8_t RATE_250KBPS = NRF_RF_SETUP::RF_DR_LOW;
+    };
+
+    /**
+     * \brief Output power levels, as value of the RF_PWR bits
+     */
+    struct NRF_TX_POWER {
+        //! -18 dBm
+        static constexpr const uint8_t POWER_MIN_18DBM = 0;
+        //! -12 dBm
+        static constexpr const uint8_t POWER_MIN_12DBM = 1;
+        //! -6 dBm
+        static constexpr const uint8_t POWER_MIN_6DBM = 2;
+        //! 0 dBm
+        static constexpr const uint8_t POWER_0DBM = 3;
+    };
+
     /**
      * \brief STATUS register bit mappings
      */
@@ -161,7 +187,7 @@ namespace nrf24l01 {
         //! Flag: Maximum number of retransmissions reached (write 1 to clear)
         static constexpr const uint8_t MAX_RT = 0x10;
         //! Pipe number of data in first slot of fifo (111 if no data is available)
-        static constexpr const uint8_t RX_P_NO = 0x0D;
+        static constexpr const uint8_t RX_P_NO = 0x0E;
         //! Flag: Transmit register is full
         static constexpr const uint8_t TX_FULL = 0x01;
     };
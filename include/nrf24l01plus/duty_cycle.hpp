@@ -0,0 +1,338 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_DUTY_CYCLE_HPP
+#define PROJECT_NRF24L01_DUTY_CYCLE_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Time spent in each power state, and the charge that used
+     *
+     * Currents default to the typical values from the datasheet (RX at 2Mbps), adjust them for the actual module.
+     */
+    struct energy_account {
+        //! Time in Power Down, in microseconds
+        uint_fast64_t power_down_us = 0;
+        //! Time in Standby-I, including the power up time, in microseconds
+        uint_fast64_t standby_us = 0;
+        //! Time in RX mode, including the RX settling time, in microseconds
+        uint_fast64_t rx_us = 0;
+        //! Payloads delivered to the receiver
+        uint32_t delivered = 0;
+
+        //! Supply current in Power Down, in microamperes
+        uint32_t power_down_ua = 1;
+        //! Supply current in Standby-I, in microamperes
+        uint32_t standby_ua = 26;
+        //! Supply current in RX mode, in microamperes
+        uint32_t rx_ua = 13500;
+
+        /**
+         * \brief Total charge used by the module, in nanocoulomb
+         */
+        uint64_t charge_nc() const {
+            return (uint64_t(power_down_us) * power_down_ua + uint64_t(standby_us) * standby_ua +
+                    uint64_t(rx_us) * rx_ua) / 1000;
+        }
+
+        /**
+         * \brief Charge used per delivered payload, in nanocoulomb, 0 if nothing was delivered
+         */
+        uint64_t charge_per_packet_nc() const {
+            return delivered == 0 ? 0 : charge_nc() / delivered;
+        }
+
+        /**
+         * \brief Share of the time spent in RX mode, in tenths of a percent
+         */
+        uint16_t rx_permille() const {
+            uint_fast64_t total = power_down_us + standby_us + rx_us;
+            return total == 0 ? 0 : uint16_t(rx_us * 1000 / total);
+        }
+    };
+
+    /**
+     * \brief Interface for receiving payloads from a duty_cycle_receiver
+     */
+    class duty_cycle_listener {
+    public:
+        /**
+         * \brief Called for every payload received during a window, except beacons
+         * @param pipe Pipe the payload was received on
+         * @param data The data
+         * @param size Size of the data
+         */
+        virtual void duty_received(uint8_t pipe, const uint8_t *data, uint8_t size) = 0;
+    };
+
+    /**
+     * \brief Receive scheduler for battery powered nodes, listening only during periodic windows
+     *
+     * Every period the module listens for window_us (PRX mode). Between windows it is powered down, and it is
+     * powered up wakeup_us before the next window, so it is in Standby-I when the window starts. Gaps too short to be
+     * worth the power up are spent in Standby-I. A window is extended by extend_us after every received payload,
+     * so a burst of messages doesn't have to wait for the next window.
+     *
+     * Latency and battery life are tuned with period_us (worst case latency) and window_us (listening cost).
+     *
+     * Windows can be aligned to a coordinator that sends a beacon at the start of every window, for example with
+     * beacon_transmitter on an interval of period_us. Senders then know the receiver listens from the beacon until
+     * window_us after it. Every received beacon resynchronizes the schedule; windows open guard_us early to absorb
+     * clock drift. After max_missed windows without a beacon, the receiver keeps listening until it hears one again.
+     *
+     * The module needs to be powered down (or in standby) with its pipes configured. service() should be called
+     * regularly; its result tells how long the microcontroller may sleep.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class duty_cycle_receiver {
+    public:
+        /**
+         * \brief Power states of the module
+         */
+        enum class state : uint8_t {
+            //! Powered down, waiting for the next window
+            power_down,
+            //! Powered up, CE low, waiting for the next window
+            standby,
+            //! Listening in PRX mode
+            listening
+        };
+
+        //! Time between window starts, in microseconds
+        uint_fast64_t period_us;
+        //! Length of a window, in microseconds
+        uint_fast64_t window_us;
+        //! Time a window is extended by after a received payload, in microseconds
+        uint_fast64_t extend_us = 0;
+        //! Time the module is powered up before a window, at least the 1.5ms power up time
+        uint_fast64_t wakeup_us = 1500;
+        //! Time a window opens early when synchronized to beacons, to absorb clock drift
+        uint_fast64_t guard_us = 500;
+        //! Pipe the coordinator beacons arrive on, or 0xFF when windows are not synchronized
+        uint8_t beacon_pipe = 0xFF;
+        //! Windows without a beacon after which the receiver listens continuously until it hears one
+        uint8_t max_missed = 4;
+        //! Time and charge accounting
+        energy_account energy;
+
+    private:
+        Radio &nrf;
+        duty_cycle_listener *listener;
+        state current = state::power_down;
+        uint_fast64_t state_since = 0;
+        uint_fast64_t window_at = 0;
+        uint_fast64_t window_end = 0;
+        uint_fast64_t powered_at = 0;
+        bool beacon_heard = false;
+        uint8_t missed = 0;
+        bool running = false;
+
+    public:
+        /**
+         * \brief Create a duty cycled receiver, call start() to start the schedule
+         * @param nrf The module
+         * @param period_us Time between window starts, in microseconds
+         * @param window_us Length of a window, in microseconds
+         * @param data_listener Listener for received payloads, can be nullptr
+         */
+        duty_cycle_receiver(Radio &nrf, uint_fast64_t period_us, uint_fast64_t window_us,
+                            duty_cycle_listener *data_listener = nullptr) :
+                period_us(period_us), window_us(window_us), nrf(nrf), listener(data_listener) {}
+
+        /**
+         * \brief Power down the module, and schedule the first window
+         * @param first_window_us Time until the first window, in microseconds, at least wakeup_us so the module can
+         * power up before it
+         */
+        void start(uint_fast64_t first_window_us = 0) {
+            uint_fast64_t now = hwlib::now_us();
+            nrf.mode(nrf.MODE_NONE);
+            nrf.power(false);
+            current = state::power_down;
+            state_since = now;
+            window_at = now + (first_window_us > wakeup_us ? first_window_us : wakeup_us);
+            missed = 0;
+            running = true;
+        }
+
+        /**
+         * \brief Stop the schedule, and power down the module
+         */
+        void stop() {
+            enter(state::power_down, hwlib::now_us());
+            running = false;
+        }
+
+        /**
+         * \brief Align the windows to a beacon received at a given time
+         *
+         * Called automatically for beacons on beacon_pipe, can be called directly when beacons are recognized
+         * differently.
+         * @param beacon_at Time the beacon was received (hwlib::now_us())
+         */
+        void synchronize(uint_fast64_t beacon_at) {
+            window_at = beacon_at;
+            window_end = beacon_at + window_us;
+            beacon_heard = true;
+            missed = 0;
+        }
+
+        /**
+         * \brief Check if the windows are aligned to the beacons
+         */
+        bool synchronized() const {
+            return beacon_pipe == 0xFF || missed <= max_missed;
+        }
+
+        /**
+         * \brief Current power state
+         */
+        state get_state() const {
+            return current;
+        }
+
+        /**
+         * \brief Move between the power states, and hand received payloads to the listener
+         *
+         * Should be called regularly, and when the IRQ pin goes low.
+         * @return Time until the next state change, in microseconds, the microcontroller can sleep until then
+         */
+        uint_fast64_t service() {
+            uint_fast64_t now = hwlib::now_us();
+            if (!running) {
+                return UINT64_MAX;
+            }
+            account(now);
+
+            uint_fast64_t opens_at = window_at - (beacon_pipe != 0xFF && window_at > guard_us ? guard_us : 0);
+            switch (current) {
+                case state::power_down:
+                    if (now + wakeup_us < opens_at) {
+                        return opens_at - wakeup_us - now;
+                    }
+                    enter(state::standby, now);
+                    [[fallthrough]];
+                case state::standby:
+                    if (now < opens_at || now < powered_at) {
+                        return (opens_at > powered_at ? opens_at : powered_at) - now;
+                    }
+                    enter(state::listening, now);
+                    // A window that opens late (the power up took longer) still gets its full length
+                    window_end = (now > window_at ? now : window_at) + window_us;
+                    beacon_heard = false;
+                    [[fallthrough]];
+                case state::listening:
+                    receive(now);
+                    if (now < window_end || !synchronized()) {
+                        return synchronized() ? window_end - now : period_us;
+                    }
+                    close_window(now);
+                    return 0;
+            }
+            return 0;
+        }
+
+        /**
+         * \brief Update the time counters to now, and get them
+         */
+        const energy_account &statistics() {
+            account(hwlib::now_us());
+            return energy;
+        }
+
+    private:
+        void receive(uint_fast64_t now) {
+            nrf.rx_drain([&](uint8_t pipe, const uint8_t *data, uint8_t width) {
+                if (pipe == beacon_pipe) {
+                    synchronize(now);
+                    return;
+                }
+                energy.delivered++;
+                if (extend_us != 0 && window_end < now + extend_us) {
+                    window_end = now + extend_us;
+                }
+                if (listener != nullptr) {
+                    listener->duty_received(pipe, data, width);
+                }
+            });
+        }
+
+        void close_window(uint_fast64_t now) {
+            if (beacon_pipe != 0xFF && !beacon_heard && missed <= max_missed) {
+                missed++;
+            }
+            do {
+                window_at += period_us;
+            } while (window_at + window_us <= now);
+
+            // A window stretched by extend_us (or a late service() call) can run into the next one
+            uint_fast64_t gap = window_at > now ? window_at - now : 0;
+            if (gap == 0) {
+                window_end = window_at + window_us;
+                beacon_heard = false;
+                return;
+            }
+            enter(gap > 2 * wakeup_us ? state::power_down : state::standby, now);
+        }
+
+        void enter(state next, uint_fast64_t now) {
+            account(now);
+            if (current == next) {
+                return;
+            }
+            switch (next) {
+                case state::power_down:
+                    nrf.mode_start(nrf.MODE_NONE);
+                    nrf.power(false);
+                    break;
+                case state::standby:
+                    nrf.mode_start(nrf.MODE_NONE);
+                    if (current == state::power_down) {
+                        nrf.power(true);
+                        powered_at = now + wakeup_us;
+                    }
+                    break;
+                case state::listening:
+                    nrf.mode_start(nrf.MODE_PRX);
+                    break;
+            }
+            current = next;
+        }
+
+        void account(uint_fast64_t now) {
+            uint_fast64_t elapsed = now - state_since;
+            state_since = now;
+            switch (current) {
+                case state::power_down:
+                    energy.power_down_us += elapsed;
+                    break;
+                case state::standby:
+                    energy.standby_us += elapsed;
+                    break;
+                case state::listening:
+                    energy.rx_us += elapsed;
+                    break;
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_DUTY_CYCLE_HPP
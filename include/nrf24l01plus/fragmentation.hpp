@@ -0,0 +1,236 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_FRAGMENTATION_HPP
+#define PROJECT_NRF24L01_FRAGMENTATION_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Header layout of message fragments
+     *
+     * Every fragment starts with 2 header bytes:
+     *  - byte 0: message id (bits 7-4), FIRST flag (bit 1), LAST flag (bit 0)
+     *  - byte 1: fragment index within the message
+     *
+     * The remaining 30 bytes of a payload carry message data. Receiving pipes need Dynamic Payload Length,
+     * since the last fragment is usually shorter.
+     */
+    struct NRF_FRAGMENT {
+        //! Size of the fragment header
+        static constexpr const uint8_t HEADER_SIZE = 2;
+        //! Message data bytes per fragment
+        static constexpr const uint8_t DATA_SIZE = 32 - HEADER_SIZE;
+        //! Largest message that can be sent
+        static constexpr const size_t MAX_MESSAGE_SIZE = 256 * DATA_SIZE;
+        //! Flag: fragment is the first of its message
+        static constexpr const uint8_t FIRST = 0x02;
+        //! Flag: fragment is the last of its message
+        static constexpr const uint8_t LAST = 0x01;
+        //! Bitmask for the message id
+        static constexpr const uint8_t MESSAGE_ID = 0xF0;
+    };
+
+    /**
+     * \brief Sends messages larger than one payload, split up in fragments
+     *
+     * Fragments are streamed through the TX FIFO (see nrf24l01plus::tx_stream_write(const uint8_t*, const uint8_t&, bool)),
+     * so they go out back to back. The module should be in PTX mode, with its TX address set.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class fragment_sender {
+        Radio &nrf;
+        uint8_t message_id = 0;
+
+    public:
+        /**
+         * \brief Create a fragment sender
+         * @param nrf Module to send on
+         */
+        explicit fragment_sender(Radio &nrf) : nrf(nrf) {}
+
+        /**
+         * \brief Send a message
+         *
+         * Blocks until all fragments have left the TX FIFO.
+         * @param data Memory location of the message
+         * @param size Size of the message, up to NRF_FRAGMENT::MAX_MESSAGE_SIZE bytes
+         * @param noack If True, fragments are sent with NO_ACK enabled
+         * @return True if all fragments were sent
+         */
+        bool send(const uint8_t *data, size_t size, bool noack = false) {
+            if (size > NRF_FRAGMENT::MAX_MESSAGE_SIZE) {
+                return false;
+            }
+            size_t fragments = size == 0 ? 1 : (size + NRF_FRAGMENT::DATA_SIZE - 1) / NRF_FRAGMENT::DATA_SIZE;
+            uint8_t payload[32];
+
+            nrf.tx_stream_begin();
+            for (size_t i = 0; i < fragments; i++) {
+                size_t offset = i * NRF_FRAGMENT::DATA_SIZE;
+                uint8_t length = size - offset < NRF_FRAGMENT::DATA_SIZE ? size - offset : NRF_FRAGMENT::DATA_SIZE;
+                payload[0] = message_id << 4 | (i == 0 ? NRF_FRAGMENT::FIRST : 0) |
+                             (i + 1 == fragments ? NRF_FRAGMENT::LAST : 0);
+                payload[1] = i;
+                for (uint8_t j = 0; j < length; j++) {
+                    payload[NRF_FRAGMENT::HEADER_SIZE + j] = data[offset + j];
+                }
+                if (!nrf.tx_stream_write(payload, NRF_FRAGMENT::HEADER_SIZE + length, noack)) {
+                    break;
+                }
+            }
+            message_id = (message_id + 1) & 0x0F;
+            return nrf.tx_stream_end();
+        }
+    };
+
+    /**
+     * \brief Reassembles fragmented messages, per pipe
+     *
+     * Fragments have to arrive in order. A missing fragment, or a message that takes longer than the timeout,
+     * causes the incomplete message to be dropped. Feed it from nrf24l01plus::rx_drain(F&&):
+     *
+     *     nrf.rx_drain([&](uint8_t pipe, const uint8_t *data, uint8_t width) {
+     *         if (reassembler.accept(pipe, data, width)) {
+     *             handle(reassembler.message(pipe), reassembler.message_size(pipe));
+     *         }
+     *     });
+     * @tparam max_message_size Size of the reassembly buffer for each pipe
+     * @tparam pipes Amount of pipes to keep buffers for
+     */
+    template<size_t max_message_size, uint8_t pipes = 6>
+    class fragment_reassembler {
+        struct reassembly {
+            uint8_t data[max_message_size];
+            size_t size;
+            uint_fast64_t started;
+            uint8_t message_id;
+            uint8_t next_index;
+            bool active;
+            bool complete;
+        };
+
+        reassembly buffers[pipes] = {};
+        uint_fast64_t timeout_us;
+
+    public:
+        //! Amount of incomplete messages that were dropped
+        uint32_t dropped = 0;
+
+        /**
+         * \brief Create a reassembler
+         * @param timeout_us Time in which all fragments of a message should arrive
+         */
+        explicit fragment_reassembler(uint_fast64_t timeout_us = 100000) : timeout_us(timeout_us) {}
+
+        /**
+         * \brief Process a received fragment
+         * @param pipe Pipe the fragment was received on
+         * @param payload The payload, including the fragment header
+         * @param width Width of the payload
+         * @param now Current time in microseconds
+         * @return True if this fragment completed a message, which can then be retrieved with message(uint8_t)
+         */
+        bool accept(uint8_t pipe, const uint8_t *payload, uint8_t width, uint_fast64_t now = hwlib::now_us()) {
+            if (pipe >= pipes || width < NRF_FRAGMENT::HEADER_SIZE) {
+                return false;
+            }
+            reassembly &buffer = buffers[pipe];
+            buffer.complete = false;
+            expire(pipe, now);
+
+            uint8_t id = payload[0] >> 4;
+            if ((payload[0] & NRF_FRAGMENT::FIRST) != 0) {
+                drop(buffer);
+                buffer.active = true;
+                buffer.message_id = id;
+                buffer.next_index = 0;
+                buffer.size = 0;
+                buffer.started = now;
+            } else if (!buffer.active || buffer.message_id != id || buffer.next_index != payload[1]) {
+                drop(buffer);
+                return false;
+            }
+
+            uint8_t length = width - NRF_FRAGMENT::HEADER_SIZE;
+            if (buffer.size + length > max_message_size) {
+                drop(buffer);
+                return false;
+            }
+            for (uint8_t i = 0; i < length; i++) {
+                buffer.data[buffer.size++] = payload[NRF_FRAGMENT::HEADER_SIZE + i];
+            }
+            buffer.next_index++;
+
+            if ((payload[0] & NRF_FRAGMENT::LAST) != 0) {
+                buffer.active = false;
+                buffer.complete = true;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * \brief Drop incomplete messages that passed their timeout
+         * @param now Current time in microseconds
+         */
+        void expire(uint_fast64_t now = hwlib::now_us()) {
+            for (uint8_t pipe = 0; pipe < pipes; pipe++) {
+                expire(pipe, now);
+            }
+        }
+
+        /**
+         * \brief Retrieve the last completed message on a pipe
+         *
+         * Only valid until the next fragment for this pipe is accepted.
+         * @param pipe Pipe number
+         * @return Memory location of the message, or nullptr if there is none
+         */
+        const uint8_t *message(uint8_t pipe) const {
+            return pipe < pipes && buffers[pipe].complete ? buffers[pipe].data : nullptr;
+        }
+
+        /**
+         * \brief Size of the last completed message on a pipe
+         * @param pipe Pipe number
+         * @return The size, or 0 if there is no completed message
+         */
+        size_t message_size(uint8_t pipe) const {
+            return pipe < pipes && buffers[pipe].complete ? buffers[pipe].size : 0;
+        }
+
+    private:
+        void drop(reassembly &buffer) {
+            if (buffer.active) {
+                dropped++;
+            }
+            buffer.active = false;
+        }
+
+        void expire(uint8_t pipe, uint_fast64_t now) {
+            if (buffers[pipe].active && now - buffers[pipe].started > timeout_us) {
+                drop(buffers[pipe]);
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_FRAGMENTATION_HPP
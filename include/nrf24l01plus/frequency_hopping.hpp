@@ -0,0 +1,512 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_FREQUENCY_HOPPING_HPP
+#define PROJECT_NRF24L01_FREQUENCY_HOPPING_HPP
+
+#include <atomic>
+#include <nrf24l01plus/nrf24l01plus.hpp>
+#include <nrf24l01plus/irq.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Pseudo random channel sequence, shared by both ends of a hopping link
+     *
+     * The channel of a slot only depends on the seed, the slot number and the set of allowed channels,
+     * so knowing the slot number is enough to get back in sync.
+     */
+    class hopping_sequence {
+        uint8_t allowed[16] = {0};
+        uint8_t count = 0;
+        uint32_t seed;
+
+    public:
+        /**
+         * \brief Create a sequence over a range of channels
+         * @param seed Seed, both ends of the link need to use the same one
+         * @param first First channel to hop over
+         * @param last Last channel to hop over
+         */
+        explicit hopping_sequence(uint32_t seed, uint8_t first = 2, uint8_t last = 80) : seed(seed) {
+            for (uint8_t channel = first; channel <= last && channel < 126; channel++) {
+                allow(channel, true);
+            }
+        }
+
+        /**
+         * \brief Add or remove a channel
+         * @param channel The channel
+         * @param value True if the channel may be used
+         */
+        void allow(uint8_t channel, bool value) {
+            if (channel >= 126 || allowed_channel(channel) == value) {
+                return;
+            }
+            allowed[channel >> 3] ^= 1u << (channel & 7);
+            count += value ? 1 : -1;
+        }
+
+        /**
+         * \brief Check if a channel may be used
+         */
+        bool allowed_channel(uint8_t channel) const {
+            return channel < 126 && (allowed[channel >> 3] & (1u << (channel & 7))) != 0;
+        }
+
+        /**
+         * \brief Amount of allowed channels
+         */
+        uint8_t allowed_count() const {
+            return count;
+        }
+
+        /**
+         * \brief Bitmap of allowed channels, one bit per channel, channel 0 in bit 0 of the first byte
+         */
+        const uint8_t *channel_map() const {
+            return allowed;
+        }
+
+        /**
+         * \brief Replace the set of allowed channels
+         * @param map Bitmap, in the format returned by channel_map()
+         */
+        void channel_map(const uint8_t *map) {
+            count = 0;
+            for (uint8_t i = 0; i < 16; i++) {
+                allowed[i] = i == 15 ? map[i] & 0x3F : map[i];
+                for (uint8_t bits = allowed[i]; bits != 0; bits &= bits - 1) {
+                    count++;
+                }
+            }
+        }
+
+        /**
+         * \brief Channel to use in a slot
+         * @param slot Slot number
+         * @return The channel
+         */
+        uint8_t channel(uint16_t slot) const {
+            if (count == 0) {
+                return 2;
+            }
+            uint32_t hash = seed ^ (slot * 0x9E3779B1u);
+            hash ^= hash >> 15;
+            hash *= 0x2C1B3C6Du;
+            hash ^= hash >> 12;
+            uint8_t index = hash % count;
+            for (uint8_t channel = 0; channel < 126; channel++) {
+                if (allowed_channel(channel) && index-- == 0) {
+                    return channel;
+                }
+            }
+            return 2;
+        }
+    };
+
+    /**
+     * \brief Interface for receiving data on the follower side of a hopping link
+     */
+    class hopping_receiver {
+    public:
+        /**
+         * \brief Called for every data frame received
+         * @param data The data
+         * @param size Size of the data
+         */
+        virtual void hop_received(const uint8_t *data, uint8_t size) = 0;
+    };
+
+    /**
+     * \brief Frequency hopping link between a leader (PTX) and a follower (PRX)
+     *
+     * The leader transmits one frame per slot, and hops to the next channel of the sequence at every slot boundary.
+     * Slot boundaries are kept on a fixed grid: when a transmission overruns its slot, the overrun slots are skipped,
+     * and nothing is sent late in a slot, when the follower may already have moved on.
+     * When it has no data to send, it sends a frame carrying its channel map, so the follower can keep following.
+     * The follower hops as soon as it received a frame (RX_DR), using the slot number in the frame, so a single received
+     * frame is enough to resynchronize. After missing frames, the follower keeps hopping on its own for a few slots,
+     * and then parks on one channel until the leader comes by.
+     *
+     * The leader keeps loss statistics per channel (from MAX_RT, or no answer within ack_timeout_us), and stops using channels whose loss rate crosses
+     * a threshold. A new channel map is announced with the slot it takes effect in. The leader only switches once the
+     * follower acknowledged the announcement, otherwise it announces a later slot. Every frame carries the epoch of the
+     * map in use, so a follower that switched at the wrong moment can switch back.
+     *
+     * Frames start with a 3 byte header (slot number, LSByte first, then map epoch in bits 7-1 and a map flag in bit 0),
+     * so data frames can carry 29 bytes. Map frames carry the activation slot and the 16 byte channel map.
+     * Both ends need Dynamic Payload Length and matching addresses.
+     * The link can be driven by polling only, or added to an irq_dispatcher (irq_driven).
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class hopping_link : public irq_listener {
+    public:
+        //! Size of the frame header
+        static constexpr const uint8_t HEADER_SIZE = 3;
+        //! Largest amount of data per frame
+        static constexpr const uint8_t MAX_DATA = 32 - HEADER_SIZE;
+        //! Amount of slots between announcing a new channel map and using it
+        static constexpr const uint8_t ACTIVATION_DELAY = 8;
+
+        //! Amount of missed slots after which the follower parks
+        uint8_t park_after = 4;
+        //! Transmissions per channel to evaluate the loss rate over
+        uint8_t loss_window = 16;
+        //! Loss percentage at which the leader blacklists a channel
+        uint8_t loss_threshold = 50;
+        //! Minimum amount of channels that are never blacklisted
+        uint8_t min_channels = 8;
+        //! Time the leader waits for TX_DS or MAX_RT before counting a frame as lost, in microseconds
+        uint_fast64_t ack_timeout_us = 100000;
+        //! Amount of frames that were not acknowledged (leader) or slots that were missed (follower)
+        uint32_t missed = 0;
+
+    private:
+        Radio &nrf;
+        hopping_sequence &sequence;
+        bool leader;
+        bool irq_driven;
+        uint_fast64_t slot_us;
+        hopping_receiver *receiver = nullptr;
+
+        uint16_t slot = 0;
+        uint8_t epoch = 0;
+        uint_fast64_t next_slot_at = 0;
+        uint_fast64_t parked_since = 0;
+        uint8_t missed_slots = 0;
+        bool awaiting = false;
+        bool awaiting_map = false;
+        uint_fast64_t ack_deadline = 0;
+        std::atomic<uint8_t> events{0};
+
+        hopping_sequence pending_sequence;
+        uint8_t pending_epoch = 0;
+        uint16_t activation = 0;
+        bool map_pending = false;
+        bool map_confirmed = false;
+        hopping_sequence previous_sequence;
+        uint8_t previous_epoch = 0;
+
+        uint8_t pending[MAX_DATA] = {0};
+        uint8_t pending_size = 0;
+        bool has_pending = false;
+
+        uint8_t attempts[126] = {0};
+        uint8_t losses[126] = {0};
+
+    public:
+        /**
+         * \brief Create a hopping link
+         * @param nrf Module to use, configured with DPL and matching addresses on both ends
+         * @param sequence Channel sequence, with the same seed and channels on both ends
+         * @param leader True for the transmitting side, false for the following receiver
+         * @param slot_us Length of a slot, should fit a transmission including retransmissions and a channel hop
+         * @param irq_driven True if this link is added to an irq_dispatcher
+         */
+        hopping_link(Radio &nrf, hopping_sequence &sequence, bool leader, uint_fast64_t slot_us = 2000,
+                     bool irq_driven = false) :
+                nrf(nrf), sequence(sequence), leader(leader), irq_driven(irq_driven), slot_us(slot_us),
+                pending_sequence(sequence), previous_sequence(sequence) {}
+
+        /**
+         * \brief Start the link on slot 0
+         * @param data_receiver Receiver for data frames (follower side), can be nullptr
+         */
+        void start(hopping_receiver *data_receiver = nullptr) {
+            receiver = data_receiver;
+            missed_slots = 0;
+            awaiting = false;
+            map_pending = false;
+            events.store(0, std::memory_order_relaxed);
+            next_slot_at = hwlib::now_us();
+            parked_since = next_slot_at;
+            if (leader) {
+                slot = UINT16_MAX;
+                nrf.mode(nrf.MODE_PTX);
+            } else {
+                hop(0);
+                nrf.mode(nrf.MODE_PRX);
+                next_slot_at += slot_us + slot_us / 2;
+            }
+        }
+
+        /**
+         * \brief Queue data to be sent in the next slot (leader side)
+         * @param data The data
+         * @param size Size of the data, at most MAX_DATA bytes
+         * @return False if data is still waiting to be sent, or the data is too large
+         */
+        bool send(const uint8_t *data, uint8_t size) {
+            if (has_pending || size > MAX_DATA) {
+                return false;
+            }
+            for (uint8_t i = 0; i < size; i++) {
+                pending[i] = data[i];
+            }
+            pending_size = size;
+            has_pending = true;
+            return true;
+        }
+
+        /**
+         * \brief Check if queued data has not been sent yet
+         */
+        bool sending() const {
+            return has_pending;
+        }
+
+        /**
+         * \brief Current slot number
+         */
+        uint16_t current_slot() const {
+            return slot;
+        }
+
+        /**
+         * \brief Epoch of the channel map in use
+         */
+        uint8_t map_epoch() const {
+            return epoch;
+        }
+
+        /**
+         * \brief Advance the link, should be called regularly
+         */
+        void poll() {
+            if (leader) {
+                poll_leader();
+            } else {
+                poll_follower();
+            }
+        }
+
+        void rx_ready() override {
+            events.fetch_or(NRF_STATUS::RX_DR, std::memory_order_release);
+        }
+
+        void tx_sent() override {
+            events.fetch_or(NRF_STATUS::TX_DS, std::memory_order_release);
+        }
+
+        void max_retransmit() override {
+            events.fetch_or(NRF_STATUS::MAX_RT, std::memory_order_release);
+        }
+
+    private:
+        void apply_pending_map() {
+            previous_sequence = sequence;
+            previous_epoch = epoch;
+            sequence = pending_sequence;
+            epoch = pending_epoch;
+            map_pending = false;
+        }
+
+        void hop(uint16_t new_slot) {
+            slot = new_slot;
+            if (map_pending && int16_t(slot - activation) >= 0) {
+                if (!leader || map_confirmed) {
+                    apply_pending_map();
+                } else {
+                    activation = slot + ACTIVATION_DELAY;
+                }
+            }
+
+            bool receiving = nrf.get_mode() == nrf.MODE_PRX;
+            if (receiving) {
+                nrf.pin_write(nrf.ce, false);
+            }
+            nrf.channel(sequence.channel(slot));
+            if (receiving) {
+                nrf.pin_write(nrf.ce, true);
+            }
+        }
+
+        void read_events() {
+            if (irq_driven) {
+                return;
+            }
+            nrf.no_operation();
+            uint8_t flags = nrf.last_status & (NRF_STATUS::RX_DR | NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT);
+            if (flags != 0) {
+                nrf.write_register(NRF_REGISTER::NRF_STATUS, flags);
+                events.fetch_or(flags, std::memory_order_relaxed);
+            }
+        }
+
+        void poll_leader() {
+            uint_fast64_t now = hwlib::now_us();
+            if (awaiting) {
+                read_events();
+                // The listener methods may run in an interrupt routine, take their flags in one atomic step
+                uint8_t flags = events.exchange(0, std::memory_order_acquire);
+                if ((flags & (NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT)) != 0) {
+                    bool success = (flags & NRF_STATUS::MAX_RT) == 0;
+                    if (success && awaiting_map && map_pending) {
+                        map_confirmed = true;
+                    }
+                    record(success);
+                    awaiting = false;
+                } else if (now > ack_deadline) {
+                    // No answer from the module at all (missed IRQ, not powered up), count it as a loss
+                    record(false);
+                    awaiting = false;
+                }
+            }
+            if (awaiting || now < next_slot_at) {
+                return;
+            }
+
+            uint16_t overrun = (now - next_slot_at) / slot_us;
+            next_slot_at += (overrun + 1) * slot_us;
+            hop(slot + 1 + overrun);
+            if (now + slot_us - next_slot_at > slot_us / 4) {
+                return;
+            }
+
+            uint8_t frame[32];
+            frame[0] = slot;
+            frame[1] = slot >> 8;
+            frame[2] = epoch << 1;
+            uint8_t size = HEADER_SIZE;
+            awaiting_map = (map_pending && !map_confirmed) || !has_pending;
+            if (!awaiting_map) {
+                for (uint8_t i = 0; i < pending_size; i++) {
+                    frame[size++] = pending[i];
+                }
+                has_pending = false;
+            } else {
+                const hopping_sequence &announced = map_pending ? pending_sequence : sequence;
+                uint16_t announced_slot = map_pending ? activation : slot;
+                frame[2] = (map_pending ? pending_epoch : epoch) << 1 | 1;
+                frame[size++] = announced_slot;
+                frame[size++] = announced_slot >> 8;
+                for (uint8_t i = 0; i < 16; i++) {
+                    frame[size++] = announced.channel_map()[i];
+                }
+            }
+            nrf.tx_write_payload(frame, size);
+            awaiting = true;
+            ack_deadline = now + ack_timeout_us;
+        }
+
+        void record(bool success) {
+            uint8_t channel = sequence.channel(slot);
+            attempts[channel]++;
+            if (!success) {
+                losses[channel]++;
+                missed++;
+                nrf.tx_flush();
+            }
+            if (attempts[channel] < loss_window) {
+                return;
+            }
+            if (uint16_t(losses[channel]) * 100 >= uint16_t(loss_threshold) * attempts[channel]) {
+                if (!map_pending) {
+                    pending_sequence = sequence;
+                }
+                if (pending_sequence.allowed_count() > min_channels && pending_sequence.allowed_channel(channel)) {
+                    pending_sequence.allow(channel, false);
+                    // Every change gets a new epoch, so a follower that holds an earlier announcement takes this one
+                    pending_epoch = ((map_pending ? pending_epoch : epoch) + 1) & 0x7F;
+                    map_pending = true;
+                    map_confirmed = false;
+                    activation = slot + ACTIVATION_DELAY;
+                }
+            }
+            attempts[channel] = 0;
+            losses[channel] = 0;
+        }
+
+        void receive_frame(const uint8_t *data, uint8_t width, uint16_t &received_slot) {
+            received_slot = data[0] | data[1] << 8;
+            uint8_t frame_epoch = data[2] >> 1;
+            if ((data[2] & 1) != 0) {
+                if (width >= HEADER_SIZE + 18 && frame_epoch != epoch) {
+                    pending_sequence.channel_map(data + HEADER_SIZE + 2);
+                    pending_epoch = frame_epoch;
+                    activation = data[HEADER_SIZE] | data[HEADER_SIZE + 1] << 8;
+                    map_pending = true;
+                }
+                return;
+            }
+
+            if (frame_epoch != epoch) {
+                if (map_pending && frame_epoch == pending_epoch) {
+                    apply_pending_map();
+                } else if (frame_epoch == previous_epoch) {
+                    hopping_sequence reverted = previous_sequence;
+                    previous_sequence = sequence;
+                    sequence = reverted;
+                    previous_epoch = epoch;
+                    epoch = frame_epoch;
+                }
+            }
+            if (receiver != nullptr) {
+                receiver->hop_received(data + HEADER_SIZE, width - HEADER_SIZE);
+            }
+        }
+
+        void poll_follower() {
+            uint_fast64_t now = hwlib::now_us();
+            read_events();
+            if ((events.fetch_and(uint8_t(~NRF_STATUS::RX_DR), std::memory_order_acquire) & NRF_STATUS::RX_DR) != 0) {
+                bool received = false;
+                uint16_t received_slot = 0;
+                nrf.rx_drain([&](uint8_t, const uint8_t *data, uint8_t width) {
+                    if (width >= HEADER_SIZE) {
+                        receive_frame(data, width, received_slot);
+                        received = true;
+                    }
+                });
+                if (received) {
+                    uint_fast64_t expected = now + slot_us + slot_us / 2;
+                    if (received_slot == slot && missed_slots == 0 && expected > next_slot_at + slot_us + slot_us / 8) {
+                        // In sync, but polled late: the frame arrived earlier than now, only follow a small drift
+                        expected = next_slot_at + slot_us + slot_us / 8;
+                    }
+                    missed_slots = 0;
+                    hop(received_slot + 1);
+                    next_slot_at = expected;
+                    return;
+                }
+            }
+            if (now < next_slot_at) {
+                return;
+            }
+
+            missed++;
+            if (missed_slots < park_after) {
+                // Slots that passed without a poll are skipped in one step, like the leader does
+                uint16_t overrun = (now - next_slot_at) / slot_us;
+                missed_slots++;
+                hop(slot + 1 + overrun);
+                next_slot_at += (overrun + 1) * slot_us;
+                parked_since = now;
+                return;
+            }
+            next_slot_at = now + slot_us;
+            if (now - parked_since > slot_us * sequence.allowed_count() * 2) {
+                hop(slot + 1);
+                parked_since = now;
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_FREQUENCY_HOPPING_HPP
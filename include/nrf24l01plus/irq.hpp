@@ -0,0 +1,129 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_IRQ_HPP
+#define PROJECT_NRF24L01_IRQ_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Interface for objects that want to be notified of NRF24L01+ interrupt events
+     *
+     * All methods have an empty default implementation, so only the events of interest need to be overridden.
+     */
+    class irq_listener {
+    public:
+        /**
+         * \brief Called when a payload was received (RX_DR)
+         */
+        virtual void rx_ready() {}
+
+        /**
+         * \brief Called when a payload was sent, or an ACK payload was transmitted (TX_DS)
+         */
+        virtual void tx_sent() {}
+
+        /**
+         * \brief Called when the maximum amount of retransmissions was reached (MAX_RT)
+         */
+        virtual void max_retransmit() {}
+    };
+
+    /**
+     * \brief Dispatches NRF24L01+ interrupts to registered listeners
+     *
+     * service() reads and clears the interrupt flags in a single SPI transaction, and calls the listeners for each event.
+     * It can be called from an interrupt routine for the IRQ pin's falling edge, or poll() can be called from the main loop,
+     * which only touches the SPI bus when the IRQ pin is low.
+     * Which events assert the IRQ pin is configured with nrf24l01plus::interrupt_mask(bool, bool, bool).
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class irq_dispatcher {
+    public:
+        //! Maximum amount of listeners
+        static constexpr const size_t MAX_LISTENERS = 4;
+
+    private:
+        Radio &nrf;
+        hwlib::pin_in &irq;
+        irq_listener *listeners[MAX_LISTENERS] = {nullptr};
+        size_t listener_count = 0;
+
+    public:
+        /**
+         * \brief Create an interrupt dispatcher
+         * @param nrf The module to handle interrupts for
+         * @param irq The (active low) IRQ pin of the module
+         */
+        irq_dispatcher(Radio &nrf, hwlib::pin_in &irq) : nrf(nrf), irq(irq) {}
+
+        /**
+         * \brief Register a listener
+         *
+         * Listeners are called in the order they were added
+         * @param listener The listener to add
+         * @return False if the maximum amount of listeners was already reached
+         */
+        bool add(irq_listener &listener) {
+            if (listener_count == MAX_LISTENERS) {
+                return false;
+            }
+            listeners[listener_count++] = &listener;
+            return true;
+        }
+
+        /**
+         * \brief Read and clear the interrupt flags, and notify the listeners
+         *
+         * Events are dispatched in the order MAX_RT, TX_DS, RX_DR.
+         * @return The interrupt flags that were set
+         */
+        uint8_t service() {
+            uint8_t flags = nrf.clear_interrupts();
+            for (size_t i = 0; i < listener_count; i++) {
+                if ((flags & NRF_STATUS::MAX_RT) != 0) {
+                    listeners[i]->max_retransmit();
+                }
+                if ((flags & NRF_STATUS::TX_DS) != 0) {
+                    listeners[i]->tx_sent();
+                }
+                if ((flags & NRF_STATUS::RX_DR) != 0) {
+                    listeners[i]->rx_ready();
+                }
+            }
+            return flags;
+        }
+
+        /**
+         * \brief Service the module if its IRQ pin is asserted
+         * @return True if an interrupt was serviced
+         */
+        bool poll() {
+            irq.refresh();
+            if (irq.read()) {
+                return false;
+            }
+            service();
+            return true;
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_IRQ_HPP
@@ -0,0 +1,221 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_LINK_QUALITY_HPP
+#define PROJECT_NRF24L01_LINK_QUALITY_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Transmission statistics of a single link
+     *
+     * The retry average is an exponential moving average of ARC_CNT, in fixed point with FRACTION_BITS fractional bits.
+     */
+    class link_statistics {
+    public:
+        //! Fractional bits of retry_average
+        static constexpr const uint8_t FRACTION_BITS = 4;
+
+        //! Amount of transmissions
+        uint32_t sent = 0;
+        //! Amount of transmissions that reached MAX_RT
+        uint32_t lost = 0;
+        //! Amount of transmissions per retransmission count
+        uint32_t retry_histogram[16] = {0};
+        //! Moving average of the retransmission count
+        uint16_t retry_average = 0;
+        //! Weight of older transmissions in the average, the newest one counts for 1 / 2^smoothing
+        uint8_t smoothing = 3;
+
+        /**
+         * \brief Record the result of a transmission
+         * @param success False if the transmission reached MAX_RT
+         * @param retries Amount of retransmissions (ARC_CNT)
+         */
+        void record(bool success, uint8_t retries) {
+            retries &= NRF_OBSERVE_TX::TX_ARC_CNT;
+            sent++;
+            if (!success) {
+                lost++;
+            }
+            retry_histogram[retries]++;
+            uint16_t target = retries << FRACTION_BITS;
+            if (target >= retry_average) {
+                retry_average += (target - retry_average) >> smoothing;
+            } else {
+                // Round the step down towards the target, so the average can reach 0 again
+                retry_average -= (retry_average - target + (1 << smoothing) - 1) >> smoothing;
+            }
+        }
+
+        /**
+         * \brief Percentage of transmissions that were lost
+         */
+        uint8_t loss_percentage() const {
+            return sent == 0 ? 0 : uint8_t(uint64_t(lost) * 100 / sent);
+        }
+
+        /**
+         * \brief Clear all statistics
+         */
+        void reset() {
+            sent = 0;
+            lost = 0;
+            retry_average = 0;
+            for (auto &count : retry_histogram) {
+                count = 0;
+            }
+        }
+    };
+
+    /**
+     * \brief Per destination link statistics, with an adaptive SETUP_RETR setting
+     *
+     * Call select() before transmitting to a destination, and record() after the transmission finished.
+     * Every evaluation_window transmissions, the retransmit delay of the destination is adjusted:
+     * links that needed no retransmissions get shorter delays for lower latency, links with lost packets or many
+     * retransmissions get longer delays, so retransmissions spread out over interference instead of all failing in it.
+     * When packets are still lost at max_delay, the link is considered (nearly) down: its retransmit count is lowered
+     * towards min_retries, so it stops blocking the sender and the channel for the full 15 retries on every payload.
+     * A window without losses raises the count again, up to max_retries.
+     * @tparam destinations Amount of destinations to keep statistics for
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<size_t destinations, typename Radio = nrf24l01plus>
+    class adaptive_retransmit {
+    public:
+        //! Shortest retransmit delay (in 250μs steps, 250μs + 250μs * min_delay), at least 1 when using large ACK payloads
+        uint8_t min_delay = 0;
+        //! Longest retransmit delay
+        uint8_t max_delay = 15;
+        //! Smallest amount of retries before giving up, for links that keep losing packets at max_delay
+        uint8_t min_retries = 3;
+        //! Largest amount of retries before giving up, used for healthy links
+        uint8_t max_retries = 15;
+        //! Amount of transmissions between evaluations
+        uint8_t evaluation_window = 16;
+        //! Retry average (in link_statistics fixed point) above which the delay is raised
+        uint16_t raise_above = 2 << link_statistics::FRACTION_BITS;
+        //! Retry average (in link_statistics fixed point) below which the delay is lowered
+        uint16_t lower_below = 1 << (link_statistics::FRACTION_BITS - 2);
+
+    private:
+        Radio &nrf;
+        link_statistics stats[destinations];
+        uint8_t delay[destinations] = {0};
+        uint8_t retries_left[destinations] = {0};
+        uint8_t window_sent[destinations] = {0};
+        uint8_t window_lost[destinations] = {0};
+        size_t selected = destinations;
+
+    public:
+        /**
+         * \brief Create a controller, with all destinations starting at initial_delay and max_retries
+         * @param nrf The module to configure
+         * @param initial_delay Starting retransmit delay
+         */
+        explicit adaptive_retransmit(Radio &nrf, uint8_t initial_delay = 1) : nrf(nrf) {
+            for (size_t i = 0; i < destinations; i++) {
+                delay[i] = initial_delay;
+                retries_left[i] = max_retries;
+            }
+        }
+
+        /**
+         * \brief Configure SETUP_RETR for a destination
+         * @param destination Index of the destination
+         */
+        void select(size_t destination) {
+            selected = destination;
+            nrf.auto_retransmit(delay[destination], retries_left[destination]);
+        }
+
+        /**
+         * \brief Record the result of a transmission, for example from a tx_completion_listener
+         * @param destination Index of the destination
+         * @param success False if the transmission reached MAX_RT
+         * @param retries Amount of retransmissions (ARC_CNT)
+         */
+        void record(size_t destination, bool success, uint8_t retries) {
+            stats[destination].record(success, retries);
+            window_sent[destination]++;
+            if (!success) {
+                window_lost[destination]++;
+            }
+            if (window_sent[destination] >= evaluation_window) {
+                evaluate(destination);
+            }
+        }
+
+        /**
+         * \brief Record the result of a transmission, reading the retransmission count from OBSERVE_TX
+         * @param destination Index of the destination
+         * @param success False if the transmission reached MAX_RT
+         */
+        void record(size_t destination, bool success) {
+            record(destination, success, nrf.tx_retransmit_count());
+        }
+
+        /**
+         * \brief Statistics of a destination
+         */
+        const link_statistics &statistics(size_t destination) const {
+            return stats[destination];
+        }
+
+        /**
+         * \brief Current retransmit delay of a destination
+         */
+        uint8_t retry_delay(size_t destination) const {
+            return delay[destination];
+        }
+
+        /**
+         * \brief Current retransmit count of a destination
+         */
+        uint8_t retry_limit(size_t destination) const {
+            return retries_left[destination];
+        }
+
+    private:
+        void evaluate(size_t destination) {
+            uint8_t &d = delay[destination];
+            uint8_t &count = retries_left[destination];
+            uint16_t average = stats[destination].retry_average;
+            if (window_lost[destination] > 0 && d >= max_delay) {
+                // Longer delays didn't help, stop spending the full retry budget on this link
+                count = count > min_retries ? count - 1 : min_retries;
+            } else if (window_lost[destination] > 0 || average > raise_above) {
+                d = d < max_delay ? d + 1 : max_delay;
+            } else if (average < lower_below) {
+                d = d > min_delay ? d - 1 : min_delay;
+            }
+            if (window_lost[destination] == 0 && count < max_retries) {
+                count++;
+            }
+            window_sent[destination] = 0;
+            window_lost[destination] = 0;
+            if (destination == selected) {
+                nrf.auto_retransmit(d, count);
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_LINK_QUALITY_HPP
@@ -0,0 +1,337 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_MULTI_RADIO_HPP
+#define PROJECT_NRF24L01_MULTI_RADIO_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+#include <nrf24l01plus/packet_pool.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Traffic counters of one radio, or of all radios of a radio_manager
+     */
+    struct radio_statistics {
+        //! Payloads that were sent successfully
+        uint32_t sent = 0;
+        //! Payloads that were not acknowledged
+        uint32_t failed = 0;
+        //! Payloads that were received
+        uint32_t received = 0;
+        //! Received payloads that were dropped because the inbound queue was full
+        uint32_t dropped = 0;
+
+        /**
+         * \brief Add the counters of another radio
+         */
+        radio_statistics &operator+=(const radio_statistics &rhs) {
+            sent += rhs.sent;
+            failed += rhs.failed;
+            received += rhs.received;
+            dropped += rhs.dropped;
+            return *this;
+        }
+    };
+
+    /**
+     * \brief Drives several modules that share one SPI bus, each with its own CSN, CE and IRQ pin
+     *
+     * All SPI traffic happens in service(), one radio at a time, so transactions for different radios never interleave.
+     * Interrupt routines only mark a radio with irq_pending(uint8_t), they don't touch the bus.
+     * service() handles the radios with a pending interrupt in priority order, and keeps every radio transmitting
+     * without blocking: while one radio waits for its acknowledgement, the others are serviced.
+     *
+     * Outbound payloads go to the least loaded radio that can reach the destination, so throughput grows with
+     * the amount of radios. Radios stay in PRX mode when they have nothing to send. Sending uses pipe 0 to receive
+     * the acknowledgement, so peers should be received on pipes 1 to 5.
+     * @tparam N Largest amount of radios, at most 8
+     * @tparam Q Queue size per direction per radio, needs to be a power of two
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<size_t N = 4, size_t Q = 8, typename Radio = nrf24l01plus>
+    class radio_manager {
+        static_assert(N > 0 && N <= 8, "A radio manager handles up to 8 radios");
+
+    public:
+        //! Time to wait for TX_DS or MAX_RT before giving up, in microseconds
+        uint_fast64_t ack_timeout_us = 100000;
+
+    private:
+        struct frame {
+            address destination;
+            packet payload;
+        };
+
+        struct radio {
+            Radio *nrf = nullptr;
+            hwlib::pin_in *irq = nullptr;
+            uint8_t priority = 0;
+            bool transmitting = false;
+            uint_fast64_t deadline = 0;
+            spsc_ring<frame, Q> outbound;
+            spsc_ring<packet, Q> inbound;
+            radio_statistics statistics;
+        };
+
+        radio radios[N];
+        uint8_t order[N] = {0};
+        uint8_t count = 0;
+        uint8_t next_receive = 0;
+        std::atomic<uint8_t> pending{0};
+
+    public:
+        radio_manager() = default;
+
+        radio_manager(const radio_manager &) = delete;
+
+        radio_manager &operator=(const radio_manager &) = delete;
+
+        /**
+         * \brief Add a radio, and put it in PRX mode
+         *
+         * The module needs to be powered up and configured (channel, addresses of pipes 1 to 5, auto acknowledgement).
+         * @param nrf The module
+         * @param irq The (active low) IRQ pin of the module, or nullptr to check the module on every service() call
+         * @param priority Radios with a higher priority are serviced first
+         * @return Index of the radio, or -1 if N radios were added already
+         */
+        int add(Radio &nrf, hwlib::pin_in *irq = nullptr, uint8_t priority = 0) {
+            if (count == N) {
+                return -1;
+            }
+            uint8_t index = count++;
+            radios[index].nrf = &nrf;
+            radios[index].irq = irq;
+            radios[index].priority = priority;
+
+            uint8_t position = index;
+            while (position > 0 && radios[order[position - 1]].priority < priority) {
+                order[position] = order[position - 1];
+                position--;
+            }
+            order[position] = index;
+
+            nrf.mode(nrf.MODE_PRX);
+            return index;
+        }
+
+        /**
+         * \brief Amount of radios
+         */
+        uint8_t size() const {
+            return count;
+        }
+
+        /**
+         * \brief Mark a radio as having an interrupt, safe to call from an interrupt routine
+         * @param index Index of the radio whose IRQ pin went low
+         */
+        void irq_pending(uint8_t index) {
+            pending.fetch_or(uint8_t(1u << index), std::memory_order_release);
+        }
+
+        /**
+         * \brief Bitmask of the radios tuned to a channel, to use with send()
+         *
+         * Reads RF_CH of every radio, which is free with the register cache enabled.
+         */
+        uint8_t radios_on(uint8_t channel) {
+            uint8_t mask = 0;
+            for (uint8_t i = 0; i < count; i++) {
+                if (radios[i].nrf->template read_register<NRF_REGISTER::RF_CH>() == channel) {
+                    mask |= 1u << i;
+                }
+            }
+            return mask;
+        }
+
+        /**
+         * \brief Queue a payload on the least loaded radio that may send it
+         *
+         * The load of a radio is the amount of payloads it has queued, including the one in flight; ties go to the radio
+         * with the fewest failed transmissions.
+         * @param destination Address to send to
+         * @param data The data
+         * @param size Size of the data, at most 32 bytes
+         * @param allowed Bitmask of the radios that can reach the destination, see radios_on(uint8_t)
+         * @return Index of the radio the payload was queued on, or -1 if all allowed radios have a full queue
+         */
+        int send(const address &destination, const uint8_t *data, uint8_t size, uint8_t allowed = 0xFF) {
+            if (size == 0 || size > 32) {
+                return -1;
+            }
+            int best = -1;
+            size_t best_load = 0;
+            for (uint8_t i = 0; i < count; i++) {
+                radio &r = radios[i];
+                if ((allowed & (1u << i)) == 0 || r.outbound.full()) {
+                    continue;
+                }
+                size_t load = r.outbound.size();
+                if (best < 0 || load < best_load ||
+                    (load == best_load && r.statistics.failed < radios[best].statistics.failed)) {
+                    best = i;
+                    best_load = load;
+                }
+            }
+            if (best < 0) {
+                return -1;
+            }
+
+            frame f = {destination, {}};
+            for (uint8_t i = 0; i < size; i++) {
+                f.payload.data[i] = data[i];
+            }
+            f.payload.length = size;
+            f.payload.timestamp = static_cast<uint32_t>(hwlib::now_us());
+            return radios[best].outbound.push(f) ? best : -1;
+        }
+
+        /**
+         * \brief Take the next received packet, going round robin over the radios
+         * @param out Packet to copy into
+         * @param from Set to the index of the radio the packet was received on
+         * @return False if no packet is waiting
+         */
+        bool receive(packet &out, uint8_t &from) {
+            for (uint8_t visited = 0; visited < count; visited++) {
+                uint8_t index = next_receive;
+                next_receive = (next_receive + 1) % count;
+                if (radios[index].inbound.pop(out)) {
+                    from = index;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * \brief Handle interrupts, move received payloads into the inbound queues, and start the next transmissions
+         *
+         * Should be called regularly from the main loop.
+         * @return Amount of radios that had an interrupt
+         */
+        uint8_t service() {
+            uint_fast64_t now = hwlib::now_us();
+            uint8_t flagged = pending.exchange(0, std::memory_order_acquire);
+            uint8_t handled = 0;
+            for (uint8_t i = 0; i < count; i++) {
+                uint8_t index = order[i];
+                radio &r = radios[index];
+                if ((flagged & (1u << index)) != 0 || irq_asserted(r)) {
+                    if (handle_events(r, now)) {
+                        handled++;
+                    }
+                }
+                if (r.transmitting && now > r.deadline) {
+                    r.nrf->tx_flush();
+                    finish(r, false);
+                }
+                if (!r.transmitting) {
+                    transmit_next(r, now);
+                }
+            }
+            return handled;
+        }
+
+        /**
+         * \brief Counters of one radio
+         */
+        const radio_statistics &statistics(uint8_t index) const {
+            return radios[index].statistics;
+        }
+
+        /**
+         * \brief Counters of all radios together
+         */
+        radio_statistics total() const {
+            radio_statistics sum;
+            for (uint8_t i = 0; i < count; i++) {
+                sum += radios[i].statistics;
+            }
+            return sum;
+        }
+
+    private:
+        static bool irq_asserted(radio &r) {
+            if (r.irq == nullptr) {
+                return true;
+            }
+            r.irq->refresh();
+            return !r.irq->read();
+        }
+
+        bool handle_events(radio &r, uint_fast64_t now) {
+            uint8_t flags = r.nrf->clear_interrupts();
+            if (r.transmitting && (flags & NRF_STATUS::MAX_RT) != 0) {
+                r.nrf->tx_flush();
+                finish(r, false);
+            } else if (r.transmitting && (flags & NRF_STATUS::TX_DS) != 0) {
+                finish(r, true);
+            }
+            if ((flags & NRF_STATUS::RX_DR) != 0) {
+                r.nrf->rx_drain([&](uint8_t pipe, const uint8_t *data, uint8_t width) {
+                    packet received = {};
+                    for (uint8_t i = 0; i < width; i++) {
+                        received.data[i] = data[i];
+                    }
+                    received.pipe = pipe;
+                    received.length = width;
+                    received.timestamp = static_cast<uint32_t>(now);
+                    if (r.inbound.push(received)) {
+                        r.statistics.received++;
+                    } else {
+                        r.statistics.dropped++;
+                    }
+                });
+            }
+            return flags != 0;
+        }
+
+        void transmit_next(radio &r, uint_fast64_t now) {
+            Radio &nrf = *r.nrf;
+            frame *next = r.outbound.peek();
+            if (next == nullptr) {
+                nrf.mode_start(nrf.MODE_PRX);
+                return;
+            }
+            nrf.mode_start(nrf.MODE_PTX);
+            if (now < nrf.mode_settled_at) {
+                return;
+            }
+            nrf.tx_set_address(next->destination);
+            nrf.rx_set_address(0, next->destination);
+            nrf.tx_write_payload(next->payload.data, next->payload.length);
+            r.transmitting = true;
+            r.deadline = now + ack_timeout_us;
+        }
+
+        void finish(radio &r, bool success) {
+            frame sent;
+            r.outbound.pop(sent);
+            r.transmitting = false;
+            if (success) {
+                r.statistics.sent++;
+            } else {
+                r.statistics.failed++;
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_MULTI_RADIO_HPP
@@ -10,6 +10,7 @@
 #ifndef PROJECT_NRF24L01_HPP
 #define PROJECT_NRF24L01_HPP
 
+#include <type_traits>
 #include <hwlib.hpp>
 #include <spi/bus_base.hpp>
 #include <nrf24l01plus/definitions.hpp>
@@ -31,27 +32,53 @@ namespace nrf24l01 {
 
     /**
      * Interface for the NRF24L01+ NRF tranceiver.
+     *
+     * The bus and pin types are template parameters. With the defaults (see nrf24l01plus), the module is accessed through
+     * the abstract spi::spi_base_bus and hwlib::pin_out interfaces. With concrete types, SPI transfers and pin writes
+     * are called directly instead of through virtual functions, so the compiler can inline the whole transaction path.
+     *
+     * The shadow register cache (see cache(bool)) costs about 150 bytes of RAM per module, so it is only compiled in
+     * when Cached is true (see cached_nrf24l01plus).
+     * @tparam Bus SPI bus type, derived from spi::spi_base_bus
+     * @tparam Pin Output pin type, derived from hwlib::pin_out
+     * @tparam Cached Compile in the shadow register cache
      */
-    class nrf24l01plus {
+    template<typename Bus = spi::spi_base_bus, typename Pin = hwlib::pin_out, bool Cached = false>
+    class basic_nrf24l01plus {
     public:
         /// \brief SPI_BUS the NRF module is connected to
-        spi::spi_base_bus &bus;
+        Bus &bus;
         /// \brief CSN pin for the NRF module
-        hwlib::pin_out &csn;
+        Pin &csn;
         /// \brief CE pin for the NRF module
-        hwlib::pin_out &ce;
+        Pin &ce;
+
+        /**
+         * \brief Get the largest register size in bytes, usable at compile time
+         *
+         * For the address registers this is the largest address width, see register_bytes(const uint8_t&) for the actual size
+         * @param address Register address to get size for
+         * @return The size
+         */
+        static constexpr uint8_t register_width(const uint8_t &address) {
+            return address == NRF_REGISTER::RX_ADDR_P0 || address == NRF_REGISTER::RX_ADDR_P1 ||
+                   address == NRF_REGISTER::TX_ADDR ? address::MAX_WIDTH : 1;
+        }
 
         /**
-         * \brief Get register size in bytes
+         * \brief Get register size in bytes, the address registers are as wide as the configured address width
          * @param address Register address to get size for
          * @return The size
          */
         uint8_t register_bytes(const uint8_t &address) {
-            if (address == NRF_REGISTER::RX_ADDR_P0 || address == NRF_REGISTER::RX_ADDR_P1 ||
-                address == NRF_REGISTER::TX_ADDR) {
-                return 5;
-            }
-            return 1;
+            return register_width(address) == 1 ? 1 : address_size;
+        }
+
+        /**
+         * \brief Address width in bytes that belongs to a SETUP_AW register value
+         */
+        static constexpr uint8_t setup_aw_width(const uint8_t &setup_aw) {
+            return (setup_aw & 0x03) == 0 ? address::MAX_WIDTH : (setup_aw & 0x03) + 2;
         }
 
         /// The mode this module is currently in
@@ -66,15 +93,117 @@ namespace nrf24l01 {
         //! The status register's last known value
         uint8_t last_status;
 
+        //! Address width in bytes, tracked from every write to SETUP_AW
+        uint8_t address_size = address::MAX_WIDTH;
+
+        //! Time (in hwlib::now_us() microseconds) at which the last mode change has settled
+        uint_fast64_t mode_settled_at = 0;
+
+        //! Bitmask of registers that hold configuration only, and can therefore be shadowed in the register cache
+        static constexpr const uint32_t CACHEABLE_REGISTERS = 0x307FFC7F;
+
+        //! True if the shadow register cache is compiled in
+        static constexpr const bool CACHE_AVAILABLE = Cached;
+
+    private:
+        struct no_register_cache {
+        };
+
+        struct register_cache {
+            //! True if register reads and writes go through the shadow register cache
+            bool enabled = false;
+            //! Bitmask of registers that currently have a valid copy in the register cache
+            uint32_t valid = 0;
+            //! Shadow copies of the configuration registers, stored in the byte order they are sent over SPI
+            uint8_t registers[NRF_REGISTER::FEATURE + 1][5] = {{0}};
+        };
+
+    public:
+        //! State of the shadow register cache, empty unless Cached is true
+        std::conditional_t<Cached, register_cache, no_register_cache> shadow;
+
+        //! Amount of TX FIFO slots that are known to be free during a TX stream
+        uint8_t tx_stream_free_slots = 0;
+
+        //! Longest time tx_stream_write() and tx_stream_end() wait for the TX FIFO, in microseconds
+        uint_fast64_t tx_stream_timeout_us = 250000;
+
+        /**
+         * \brief Check if a register can be kept in the shadow register cache
+         *
+         * Registers the NRF24L01+ changes by itself (STATUS, OBSERVE_TX, RPD and FIFO_STATUS) are never cached.
+         * @param address Register address to check
+         * @return True if the register is cacheable
+         */
+        static constexpr bool register_cacheable(const uint8_t &address) {
+            return address <= NRF_REGISTER::FEATURE && ((CACHEABLE_REGISTERS >> address) & 1u) != 0;
+        }
+
         /**
          * Create NRF24L01Plus object
          * @param bus Spi_Bus to use for communication
          * @param csn Chip Select pin
          * @param ce Chip Enable Pin
          */
-        nrf24l01plus(spi::spi_base_bus &bus, hwlib::pin_out &csn, hwlib::pin_out &ce) : bus(bus),
-                                                                                        csn(csn),
-                                                                                        ce(ce), last_status(0) {}
+        basic_nrf24l01plus(Bus &bus, Pin &csn, Pin &ce) : bus(bus), csn(csn), ce(ce), last_status(0) {}
+
+    private:
+        /**
+         * \brief SPI transaction on concrete bus and pin types, without virtual calls
+         */
+        class direct_transaction {
+            basic_nrf24l01plus &nrf;
+
+        public:
+            explicit direct_transaction(basic_nrf24l01plus &nrf) : nrf(nrf) {
+                nrf.pin_write(nrf.csn, false);
+            }
+
+            direct_transaction(const direct_transaction &) = delete;
+
+            ~direct_transaction() {
+                nrf.pin_write(nrf.csn, true);
+            }
+
+            direct_transaction &write_read(const size_t &n, const uint8_t *data_out, uint8_t *data_in) {
+                nrf.bus.Bus::write_read(n, data_out, data_in);
+                return *this;
+            }
+
+            direct_transaction &write_read_reverse(const size_t &n, const uint8_t *data_out, uint8_t *data_in) {
+                nrf.bus.Bus::write_read_reverse(n, data_out, data_in);
+                return *this;
+            }
+        };
+
+        static constexpr const bool DIRECT = !std::is_abstract<Bus>::value && !std::is_abstract<Pin>::value;
+
+    public:
+        /**
+         * \brief Start an SPI transaction with the module, CSN is released when the returned object goes out of scope
+         */
+        auto begin_transaction() {
+            if constexpr (DIRECT) {
+                return direct_transaction(*this);
+            } else {
+                return bus.transaction(csn);
+            }
+        }
+
+        /**
+         * \brief Write and flush a pin, directly if its type is concrete
+         * @param pin The pin (csn or ce)
+         * @param value The value to write
+         */
+        void pin_write(Pin &pin, bool value) {
+            if constexpr (DIRECT) {
+                pin.Pin::write(value);
+                pin.Pin::flush();
+            } else {
+                pin.write(value);
+                pin.flush();
+            }
+        }
 
         /**
          * \brief Sends SPI command to NRF24L01Plus device
@@ -90,7 +219,7 @@ namespace nrf24l01 {
          */
         void send_command(const uint8_t &command_word, const uint8_t *data_out = nullptr, const uint8_t &n = 0,
                           uint8_t *data_in = nullptr, bool lsbyte_first = false) {
-            auto transaction = bus.transaction(csn);
+            auto transaction = begin_transaction();
             transaction.write_read(1, &command_word, &last_status);
             if (n == 0) {
                 return;
@@ -128,7 +257,11 @@ namespace nrf24l01 {
          * @param lsbyte_first Should the data be read LSByte first (reversed)
          */
         void read_register(const uint8_t &address, uint8_t *in = nullptr, bool lsbyte_first = false) {
-            send_command(NRF_INSTRUCTION::R_REGISTER | address, nullptr, register_bytes(address), in, lsbyte_first);
+            if (!cache_enabled() || !register_cacheable(address)) {
+                send_command(NRF_INSTRUCTION::R_REGISTER | address, nullptr, register_bytes(address), in, lsbyte_first);
+                return;
+            }
+            cache_load(address, register_bytes(address), in, lsbyte_first);
         }
 
         /**
@@ -155,6 +288,13 @@ namespace nrf24l01 {
          * @param lsbyte_first Should the written data be written LSByte first (reversed)
          */
         void write_register(const uint8_t &address, const uint8_t *data, bool lsbyte_first = false) {
+            if (address == NRF_REGISTER::SETUP_AW) {
+                address_size = setup_aw_width(data[0]);
+            }
+            if (cache_enabled() && register_cacheable(address) &&
+                !cache_store(address, register_bytes(address), data, lsbyte_first)) {
+                return;
+            }
             send_command(NRF_INSTRUCTION::W_REGISTER | address, data, register_bytes(address), nullptr, lsbyte_first);
         }
 
@@ -183,6 +323,178 @@ namespace nrf24l01 {
             write_register(address, &data);
         }
 
+        /**
+         * \brief Read a register whose address is known at compile time
+         *
+         * The register width (except for the address width) and cacheability are resolved at compile time,
+         * so this compiles to straight-line code.
+         * @tparam address Address of the register to read
+         * @param in Memory location to read register into, at least register_width(address) bytes
+         * @param lsbyte_first Should the data be read LSByte first (reversed)
+         */
+        template<uint8_t address>
+        void read_register(uint8_t *in, bool lsbyte_first = false) {
+            static_assert(address <= NRF_REGISTER::FEATURE, "Unknown register address");
+            const uint8_t n = register_width(address) == 1 ? 1 : address_size;
+            if constexpr (register_cacheable(address)) {
+                if (cache_enabled()) {
+                    cache_load(address, n, in, lsbyte_first);
+                    return;
+                }
+            }
+            send_command(NRF_INSTRUCTION::R_REGISTER | address, nullptr, n, in, lsbyte_first);
+        }
+
+        /**
+         * \brief Read a single byte register whose address is known at compile time
+         * @tparam address Address of the register to read
+         * @return The register value
+         */
+        template<uint8_t address>
+        uint8_t read_register() {
+            static_assert(register_width(address) == 1, "Register is wider than one byte");
+            uint8_t value = 0;
+            read_register<address>(&value);
+            return value;
+        }
+
+        /**
+         * \brief Write a register whose address is known at compile time
+         *
+         * The register width (except for the address width) and cacheability are resolved at compile time,
+         * so this compiles to straight-line code.
+         * @tparam address Address of the register to write to
+         * @param data Pointer to the data to write into the register, register_width(address) bytes
+         * @param lsbyte_first Should the written data be written LSByte first (reversed)
+         */
+        template<uint8_t address>
+        void write_register(const uint8_t *data, bool lsbyte_first = false) {
+            static_assert(address <= NRF_REGISTER::FEATURE, "Unknown register address");
+            const uint8_t n = register_width(address) == 1 ? 1 : address_size;
+            if constexpr (address == NRF_REGISTER::SETUP_AW) {
+                address_size = setup_aw_width(data[0]);
+            }
+            if constexpr (register_cacheable(address)) {
+                if (cache_enabled() && !cache_store(address, n, data, lsbyte_first)) {
+                    return;
+                }
+            }
+            send_command(NRF_INSTRUCTION::W_REGISTER | address, data, n, nullptr, lsbyte_first);
+        }
+
+        /**
+         * \brief Write a single byte register whose address is known at compile time
+         *
+         * For example write_register<NRF_REGISTER::RF_CH>(76)
+         * @tparam address Address of the register to write to
+         * @param data Data to write into the register
+         */
+        template<uint8_t address>
+        void write_register(uint8_t data) {
+            static_assert(register_width(address) == 1, "Register is wider than one byte");
+            write_register<address>(&data);
+        }
+
+        /**
+         * \brief Read a register through the register cache, loading it from the module if it is not cached yet
+         * @param address Address of a cacheable register
+         * @param n Width of the register
+         * @param in Memory location to read register into, can be nullptr to only load the cache
+         * @param lsbyte_first Should the data be read LSByte first (reversed)
+         */
+        void cache_load(const uint8_t &address, const uint8_t &n, uint8_t *in, bool lsbyte_first) {
+            if constexpr (Cached) {
+                uint8_t *cached = shadow.registers[address];
+                if ((shadow.valid & (1u << address)) == 0) {
+                    send_command(NRF_INSTRUCTION::R_REGISTER | address, nullptr, n, cached);
+                    shadow.valid |= 1u << address;
+                }
+                if (in == nullptr) {
+                    return;
+                }
+                for (uint8_t i = 0; i < n; i++) {
+                    in[i] = cached[lsbyte_first ? n - 1 - i : i];
+                }
+            }
+        }
+
+        /**
+         * \brief Store a value that is about to be written in the register cache
+         * @param address Address of a cacheable register
+         * @param n Width of the register
+         * @param data The data to be written
+         * @param lsbyte_first Is the data written LSByte first (reversed)
+         * @return False if the register already holds this value, so the write can be skipped
+         */
+        bool cache_store(const uint8_t &address, const uint8_t &n, const uint8_t *data, bool lsbyte_first) {
+            if constexpr (Cached) {
+                uint8_t *cached = shadow.registers[address];
+                bool changed = (shadow.valid & (1u << address)) == 0;
+                for (uint8_t i = 0; i < n; i++) {
+                    uint8_t byte = data[lsbyte_first ? n - 1 - i : i];
+                    changed |= cached[i] != byte;
+                    cached[i] = byte;
+                }
+                shadow.valid |= 1u << address;
+                return changed;
+            }
+            return true;
+        }
+
+        /**
+         * \brief Enable or disable the shadow register cache, only available when Cached is true
+         *
+         * While enabled, reads of configuration registers are answered from the cache, and writes that would not change
+         * a register's value are skipped entirely. This turns the read-modify-write setters into at most one SPI transaction.
+         * Note that a cache hit does not update last_status, use no_operation() when an up to date status is needed.
+         * Enabling the cache starts with an empty cache, registers are loaded on first access.
+         * @param enabled True if the cache should be used
+         */
+        void cache(bool enabled) {
+            static_assert(Cached, "The register cache is not compiled in, use basic_nrf24l01plus<Bus, Pin, true>");
+            shadow.enabled = enabled;
+            shadow.valid = 0;
+        }
+
+        /**
+         * \brief Check if register reads and writes go through the shadow register cache
+         */
+        bool cache_enabled() const {
+            if constexpr (Cached) {
+                return shadow.enabled;
+            }
+            return false;
+        }
+
+        /**
+         * \brief Invalidate the shadow register cache
+         *
+         * Should be called whenever the registers may have changed without this object knowing about it,
+         * for example after a power cycle of the module, or when another driver has accessed it.
+         */
+        void cache_invalidate() {
+            if constexpr (Cached) {
+                shadow.valid = 0;
+            }
+        }
+
+        /**
+         * \brief Reload all cacheable registers from the NRF24L01+
+         *
+         * Unlike cache_invalidate(), this reads every register immediately, so later reads never have to wait for SPI.
+         */
+        void cache_resync() {
+            if (!cache_enabled()) {
+                return;
+            }
+            cache_invalidate();
+            for (uint8_t address = 0; address <= NRF_REGISTER::FEATURE; address++) {
+                if (register_cacheable(address)) {
+                    read_register(address);
+                }
+            }
+        }
+
         /**
          * \brief No Operation, can be used to retrieve last_status
          */
@@ -197,7 +509,29 @@ namespace nrf24l01 {
          * @param retry_count Amount of retries before giving up
          */
         void auto_retransmit(uint8_t retry_delay, uint8_t retry_count) {
-            write_register(NRF_REGISTER::SETUP_RETR, retry_delay << 4 | retry_count);
+            write_register<NRF_REGISTER::SETUP_RETR>(retry_delay << 4 | retry_count);
+        }
+
+        /**
+         * \brief Amount of retransmissions of the last transmission (ARC_CNT)
+         *
+         * Reset when a new transmission starts
+         */
+        uint8_t tx_retransmit_count() {
+            uint8_t observe = 0;
+            read_register<NRF_REGISTER::OBSERVE_TX>(&observe);
+            return observe & NRF_OBSERVE_TX::TX_ARC_CNT;
+        }
+
+        /**
+         * \brief Amount of lost packets (PLOS_CNT)
+         *
+         * Counts up to 15, reset by writing the RF channel
+         */
+        uint8_t tx_lost_count() {
+            uint8_t observe = 0;
+            read_register<NRF_REGISTER::OBSERVE_TX>(&observe);
+            return (observe & NRF_OBSERVE_TX::TX_PLOS_CNT) >> 4;
         }
 
         /**
@@ -206,7 +540,65 @@ namespace nrf24l01 {
          * @param channel  Channel offset from 2.4gHz (in mHz)
          */
         void channel(uint8_t channel) {
-            write_register(NRF_REGISTER::RF_CH, channel & uint8_t(0xEF));
+            write_register<NRF_REGISTER::RF_CH>(channel & uint8_t(0x7F));
+        }
+
+        /**
+         * \brief Set the air data rate, both ends of a link need to use the same rate
+         *
+         * @param rate One of the NRF_DATA_RATE values
+         */
+        void data_rate(uint8_t rate) {
+            uint8_t setup;
+            read_register<NRF_REGISTER::RF_SETUP>(&setup);
+            setup &= ~(NRF_RF_SETUP::RF_DR_LOW | NRF_RF_SETUP::RF_DR_HIGH);
+            write_register<NRF_REGISTER::RF_SETUP>(setup | (rate & (NRF_RF_SETUP::RF_DR_LOW | NRF_RF_SETUP::RF_DR_HIGH)));
+        }
+
+        /**
+         * \brief Get the air data rate
+         *
+         * @return One of the NRF_DATA_RATE values
+         */
+        uint8_t data_rate() {
+            uint8_t setup;
+            read_register<NRF_REGISTER::RF_SETUP>(&setup);
+            return setup & (NRF_RF_SETUP::RF_DR_LOW | NRF_RF_SETUP::RF_DR_HIGH);
+        }
+
+        /**
+         * \brief Set the output power in TX mode
+         *
+         * @param level One of the NRF_TX_POWER values
+         */
+        void tx_power(uint8_t level) {
+            uint8_t setup;
+            read_register<NRF_REGISTER::RF_SETUP>(&setup);
+            setup &= ~NRF_RF_SETUP::RF_PWR;
+            write_register<NRF_REGISTER::RF_SETUP>(setup | ((level << 1) & NRF_RF_SETUP::RF_PWR));
+        }
+
+        /**
+         * \brief Get the output power in TX mode
+         *
+         * @return One of the NRF_TX_POWER values
+         */
+        uint8_t tx_power() {
+            uint8_t setup;
+            read_register<NRF_REGISTER::RF_SETUP>(&setup);
+            return (setup & NRF_RF_SETUP::RF_PWR) >> 1;
+        }
+
+        /**
+         * \brief Read the Received Power Detector
+         *
+         * Only valid in PRX mode, at least 170μs after the receiver was enabled
+         * @return True if a signal stronger than -64dBm is present on the current channel
+         */
+        bool received_power_detector() {
+            uint8_t rpd;
+            read_register<NRF_REGISTER::RPD>(&rpd);
+            return (rpd & 0x01) != 0;
         }
 
         /**
@@ -215,7 +607,9 @@ namespace nrf24l01 {
          * @param address Pointer to location of address.
          */
         void tx_set_address(const address &address) {
-            write_register(NRF_REGISTER::TX_ADDR, address.address_bytes, true);
+            uint8_t data[address::MAX_WIDTH];
+            address.to_bytes(data);
+            write_register<NRF_REGISTER::TX_ADDR>(data);
         }
 
         /**
@@ -224,9 +618,34 @@ namespace nrf24l01 {
          * @return The address
          */
         address tx_get_address() {
-            uint8_t data[5];
-            read_register(NRF_REGISTER::TX_ADDR, data);
-            return {data[0], data[1], data[2], data[3], data[4]};
+            uint8_t data[address::MAX_WIDTH];
+            read_register<NRF_REGISTER::TX_ADDR>(data);
+            return address::from_bytes(data, address_size);
+        }
+
+        /**
+         * \brief Set the address width of all pipes and the TX address
+         *
+         * Shorter addresses save a byte of airtime per packet, and SPI bytes for every address change.
+         * Set the addresses again after changing the width.
+         * @param width Address width in bytes (3-5)
+         * @return False if the width is out of range, the module is left unchanged then
+         */
+        bool address_width(uint8_t width) {
+            if (width < address::MIN_WIDTH || width > address::MAX_WIDTH) {
+                return false;
+            }
+            write_register<NRF_REGISTER::SETUP_AW>(uint8_t(width - 2));
+            return true;
+        }
+
+        /**
+         * \brief Get the address width, as read from the module
+         * @return Address width in bytes (3-5)
+         */
+        uint8_t address_width() {
+            address_size = setup_aw_width(read_register<NRF_REGISTER::SETUP_AW>());
+            return address_size;
         }
 
         /**
@@ -246,35 +665,54 @@ namespace nrf24l01 {
          *  1: Primary Transmit
          *  2: Primary Receive
          *  When the new mode is equal to the old mode, this method doesn't do anything.
+         *  This method blocks until the module has settled in its new mode, see nrf24l01plus::mode_start(uint8_t) for a non-blocking alternative.
          * @param newMode
          */
         void mode(uint8_t newMode) {
             if (currentMode == newMode) {
                 return;
             }
-            bool fromActiveState = currentMode == MODE_PRX || currentMode == MODE_PTX;
-
-            currentMode = newMode;
-            if (fromActiveState) {
-                ce.write(false);
-                ce.flush();
+            if (currentMode == MODE_PRX || currentMode == MODE_PTX) {
+                pin_write(ce, false);
                 hwlib::wait_us(130);
             }
 
+            mode_start(newMode);
+            uint_fast64_t now = hwlib::now_us();
+            if (now < mode_settled_at) {
+                hwlib::wait_us(mode_settled_at - now);
+            }
+        }
+
+        /**
+         * \brief Start switching to another operating mode, without waiting for the module to settle
+         *
+         * See nrf24l01plus::mode(uint8_t) for the operating modes.
+         * Use nrf24l01plus::mode_ready() to check if the module has settled.
+         * @param newMode
+         */
+        void mode_start(uint8_t newMode) {
+            if (currentMode == newMode) {
+                return;
+            }
+            if (currentMode == MODE_PRX || currentMode == MODE_PTX) {
+                pin_write(ce, false);
+            }
 
+            currentMode = newMode;
+            mode_settled_at = hwlib::now_us();
             uint8_t lastConfig;
             switch (newMode) {
                 case 1:
-                    read_register(NRF_REGISTER::CONFIG, &lastConfig);
-                    write_register(NRF_REGISTER::CONFIG, lastConfig & ~NRF_CONFIG::CONFIG_PRIM_RX);
+                    read_register<NRF_REGISTER::CONFIG>(&lastConfig);
+                    write_register<NRF_REGISTER::CONFIG>(lastConfig & ~NRF_CONFIG::CONFIG_PRIM_RX);
                     break;
 
                 case 2:
-                    read_register(NRF_REGISTER::CONFIG, &lastConfig);
-                    write_register(NRF_REGISTER::CONFIG, lastConfig | NRF_CONFIG::CONFIG_PRIM_RX);
-                    ce.write(true);
-                    ce.flush();
-                    hwlib::wait_us(130);
+                    read_register<NRF_REGISTER::CONFIG>(&lastConfig);
+                    write_register<NRF_REGISTER::CONFIG>(lastConfig | NRF_CONFIG::CONFIG_PRIM_RX);
+                    pin_write(ce, true);
+                    mode_settled_at = hwlib::now_us() + 130;
                     break;
 
                 case 0:
@@ -283,8 +721,15 @@ namespace nrf24l01 {
                 }
 
             }
+        }
 
-
+        /**
+         * \brief Check if the module has settled after the last mode change
+         *
+         * @return True if the module is ready to be used in its current mode
+         */
+        bool mode_ready() {
+            return hwlib::now_us() >= mode_settled_at;
         }
 
         /**
@@ -293,13 +738,52 @@ namespace nrf24l01 {
          */
         void power(bool value) {
             uint8_t lastConfig;
-            read_register(NRF_REGISTER::CONFIG, &lastConfig);
+            read_register<NRF_REGISTER::CONFIG>(&lastConfig);
             if (value) {
                 lastConfig |= NRF_CONFIG::CONFIG_PWR_UP;
             } else {
                 lastConfig &= ~NRF_CONFIG::CONFIG_PWR_UP;
             }
-            write_register(NRF_REGISTER::CONFIG, &lastConfig);
+            write_register<NRF_REGISTER::CONFIG>(&lastConfig);
+        }
+
+        /**
+         * \brief Select which events are reflected on the IRQ pin
+         *
+         * @param rx_ready True if RX_DR should trigger an interrupt
+         * @param tx_sent True if TX_DS should trigger an interrupt
+         * @param max_retransmit True if MAX_RT should trigger an interrupt
+         */
+        void interrupt_mask(bool rx_ready, bool tx_sent, bool max_retransmit) {
+            uint8_t lastConfig;
+            read_register<NRF_REGISTER::CONFIG>(&lastConfig);
+            lastConfig &= ~(NRF_CONFIG::MASK_RX | NRF_CONFIG::MASK_TX_DS | NRF_CONFIG::MASK_MAX_RT);
+            if (!rx_ready) {
+                lastConfig |= NRF_CONFIG::MASK_RX;
+            }
+            if (!tx_sent) {
+                lastConfig |= NRF_CONFIG::MASK_TX_DS;
+            }
+            if (!max_retransmit) {
+                lastConfig |= NRF_CONFIG::MASK_MAX_RT;
+            }
+            write_register<NRF_REGISTER::CONFIG>(&lastConfig);
+        }
+
+        /**
+         * \brief Read and clear the interrupt flags, in a single SPI transaction
+         *
+         * The status byte clocked out with the command is used to clear exactly the flags that were set,
+         * so events that happen during the transaction are not lost.
+         * @return The interrupt flags (RX_DR, TX_DS, MAX_RT) that were set, the full status is saved in last_status
+         */
+        uint8_t clear_interrupts() {
+            const uint8_t command_word = NRF_INSTRUCTION::W_REGISTER | NRF_REGISTER::NRF_STATUS;
+            auto transaction = begin_transaction();
+            transaction.write_read(1, &command_word, &last_status);
+            uint8_t flags = last_status & (NRF_STATUS::RX_DR | NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT);
+            transaction.write_read(1, &flags, nullptr);
+            return flags;
         }
 
         /**
@@ -309,7 +793,7 @@ namespace nrf24l01 {
          */
         uint8_t fifo_status() {
             uint8_t status;
-            read_register(NRF_REGISTER::FIFO_STATUS, &status);
+            read_register<NRF_REGISTER::FIFO_STATUS>(&status);
             return status;
         }
 
@@ -358,15 +842,114 @@ namespace nrf24l01 {
             send_command(NRF_INSTRUCTION::FLUSH_RX);
         }
 
+        /**
+         * \brief Pipe number of the first payload in the RX FIFO, according to last_status
+         *
+         * @return The pipe number, or 7 if the RX FIFO was empty
+         */
+        uint8_t rx_pipe() {
+            return (last_status & NRF_STATUS::RX_P_NO) >> 1;
+        }
+
+        /**
+         * \brief Read the first payload in the RX FIFO, if there is one
+         *
+         * The status byte returned by R_RX_PL_WID is used to find the pipe of the payload, afterwards rx_pipe() returns it.
+         * For pipes without Dynamic Payload Length, the payload width is read from RX_PW_Px. Enable the register cache
+         * to make this free.
+         * Payloads with an invalid width (more than 32 bytes) are flushed, as advised in the datasheet.
+         * @param data Memory location to read the payload into, at least 32 bytes
+         * @param dynpd Value of the DYNPD register
+         * @return Width of the payload, or 0 if the RX FIFO was empty (rx_pipe() is 7) or the payload was flushed
+         */
+        uint8_t rx_read_next(uint8_t *data, const uint8_t &dynpd = 0x3F) {
+            uint8_t width;
+            send_command(NRF_INSTRUCTION::R_RX_PL_WID, nullptr, 1, &width);
+            uint8_t pipe = rx_pipe();
+            if (pipe > 5) {
+                return 0;
+            }
+            if ((dynpd & (1u << pipe)) == 0) {
+                width = rx_get_payload_width(pipe);
+            }
+            if (width > 32) {
+                rx_flush();
+                return 0;
+            }
+            rx_read_payload(data, width);
+            return width;
+        }
+
+        /**
+         * \brief Clear RX_DR, after the RX FIFO was found empty
+         *
+         * The status byte clocked out while clearing shows if a payload arrived in the meantime.
+         * @return True if the RX FIFO is no longer empty, and should be read again
+         */
+        bool rx_clear_data_ready() {
+            if ((last_status & NRF_STATUS::RX_DR) == 0) {
+                return false;
+            }
+            write_register<NRF_REGISTER::NRF_STATUS>(uint8_t(NRF_STATUS::RX_DR));
+            return rx_pipe() <= 5;
+        }
+
+        /**
+         * \brief Read every payload in the RX FIFO
+         *
+         * Each payload is read into buffer using nrf24l01plus::rx_read_next(uint8_t*, const uint8_t&),
+         * after which handler(pipe, buffer, width) is called.
+         * No FIFO_STATUS reads are needed, and RX_DR is cleared once, after the RX FIFO has been emptied.
+         * @tparam F Handler type, callable with (uint8_t pipe, const uint8_t *data, uint8_t width)
+         * @param buffer Memory location to read payloads into, at least 32 bytes
+         * @param handler Handler to call for every payload
+         * @return Amount of payloads read
+         */
+        template<typename F>
+        uint8_t rx_drain(uint8_t *buffer, F &&handler) {
+            uint8_t count = 0;
+            uint8_t dynpd;
+            read_register<NRF_REGISTER::DYNPD>(&dynpd);
+            while (true) {
+                uint8_t width = rx_read_next(buffer, dynpd);
+                uint8_t pipe = rx_pipe();
+                if (pipe > 5) {
+                    if (!rx_clear_data_ready()) {
+                        return count;
+                    }
+                    continue;
+                }
+                if (width == 0) {
+                    continue;
+                }
+                handler(pipe, static_cast<const uint8_t *>(buffer), width);
+                count++;
+            }
+        }
+
+        /**
+         * \brief Read every payload in the RX FIFO, using an internal buffer
+         *
+         * See nrf24l01plus::rx_drain(uint8_t*, F&&)
+         * @tparam F Handler type, callable with (uint8_t pipe, const uint8_t *data, uint8_t width)
+         * @param handler Handler to call for every payload
+         * @return Amount of payloads read
+         */
+        template<typename F>
+        uint8_t rx_drain(F &&handler) {
+            uint8_t buffer[32];
+            return rx_drain(buffer, handler);
+        }
+
 
 //////////////////////////////////////////////////////////////////////////////  TX Payload Functions
         /**
          * \brief Transmit the first available TX Payload in TX FIFO register
          */
         void tx_send_payload() {
-            ce.write(true);
+            pin_write(ce, true);
             hwlib::wait_us(10);
-            ce.write(false);
+            pin_write(ce, false);
         }
 
         /**
@@ -378,13 +961,8 @@ namespace nrf24l01 {
          * @param size Size of the data to write
          * @param noack If True, the payload is written with NO_ACK enabled
          */
-        void tx_write_payload(uint8_t *data, const uint8_t &size, bool noack = false) {
-            if (noack) {
-                send_command(NRF_INSTRUCTION::W_TX_PAYLOAD_NO_ACK, data, size, nullptr);
-            } else {
-                send_command(NRF_INSTRUCTION::W_TX_PAYLOAD, data, size, nullptr);
-            }
-
+        void tx_write_payload(const uint8_t *data, const uint8_t &size, bool noack = false) {
+            tx_queue_payload(data, size, noack);
             tx_send_payload();
         }
 
@@ -402,6 +980,22 @@ namespace nrf24l01 {
         }
 
 
+        /**
+         * \brief Write data into TX FIFO register, without transmitting it
+         *
+         * For using NOACK, the feature needs to be enabled in the FEATURE register
+         * @param data Memory location to write data from
+         * @param size Size of the data to write
+         * @param noack If True, the payload is written with NO_ACK enabled
+         */
+        void tx_queue_payload(const uint8_t *data, const uint8_t &size, bool noack = false) {
+            if (noack) {
+                send_command(NRF_INSTRUCTION::W_TX_PAYLOAD_NO_ACK, data, size, nullptr);
+            } else {
+                send_command(NRF_INSTRUCTION::W_TX_PAYLOAD, data, size, nullptr);
+            }
+        }
+
         /**
          * \brief Clear TX FIFO register
          */
@@ -409,6 +1003,122 @@ namespace nrf24l01 {
             send_command(NRF_INSTRUCTION::FLUSH_TX);
         }
 
+        /**
+         * \brief Keep the last payload in the TX FIFO after it was sent, so every CE pulse sends it again
+         *
+         * Reuse stays active until a new payload is written or the TX FIFO is flushed.
+         * It must not be activated or deactivated during a transmission.
+         */
+        void tx_reuse_payload() {
+            send_command(NRF_INSTRUCTION::REUSE_TX_PL);
+        }
+
+        /**
+         * \brief Check if the last payload is being reused, see nrf24l01plus::tx_reuse_payload()
+         */
+        bool tx_reusing() {
+            return (fifo_status() & NRF_FIFO_STATUS::TX_REUSE) != 0;
+        }
+
+        /**
+         * \brief Start streaming payloads through the TX FIFO
+         *
+         * The module should be in PTX mode. While streaming, CE is kept asserted, so the module transmits payloads
+         * back to back instead of returning to standby between them.
+         */
+        void tx_stream_begin() {
+            uint8_t status = fifo_status();
+            if ((status & NRF_FIFO_STATUS::TX_EMPTY) != 0) {
+                tx_stream_free_slots = 3;
+            } else {
+                tx_stream_free_slots = (status & NRF_FIFO_STATUS::TX_FULL) != 0 ? 0 : 1;
+            }
+        }
+
+        /**
+         * \brief Add a payload to the TX stream
+         *
+         * Blocks until there is room in the TX FIFO, at most tx_stream_timeout_us. The first payload asserts CE.
+         * For using NOACK, the feature needs to be enabled in the FEATURE register
+         * @param data Memory location to write data from
+         * @param size Size of the data to write
+         * @param noack If True, the payload is written with NO_ACK enabled
+         * @return False if the module reached the maximum amount of retransmissions, or the TX FIFO stayed full until
+         * the timeout, the payload is not written in that case
+         */
+        bool tx_stream_write(const uint8_t *data, const uint8_t &size, bool noack = false) {
+            uint_fast64_t deadline = hwlib::now_us() + tx_stream_timeout_us;
+            while (tx_stream_free_slots == 0) {
+                no_operation();
+                if ((last_status & NRF_STATUS::MAX_RT) != 0 || hwlib::now_us() > deadline) {
+                    return false;
+                }
+                if ((last_status & NRF_STATUS::TX_FULL) == 0) {
+                    tx_stream_free_slots = 1;
+                }
+            }
+            tx_queue_payload(data, size, noack);
+            tx_stream_free_slots--;
+            pin_write(ce, true);
+            return true;
+        }
+
+        /**
+         * \brief Add a payload to the TX stream
+         *
+         * @tparam n Size of the data to write
+         * @param out Array of data to write
+         * @param noack If True, the payload is written with NO_ACK enabled
+         * @return False if the module reached the maximum amount of retransmissions
+         */
+        template<size_t n>
+        bool tx_stream_write(const std::array<uint8_t, n> &out, bool noack = false) {
+            return tx_stream_write(out.begin(), n, noack);
+        }
+
+        /**
+         * \brief Wait for the TX stream to drain, and release CE
+         *
+         * When the maximum amount of retransmissions is reached, or the TX FIFO did not drain within tx_stream_timeout_us
+         * (for example because the module is not powered up), the remaining payloads are flushed and the MAX_RT flag
+         * is cleared. The TX_DS flag is cleared as well.
+         * @return True if all payloads were sent
+         */
+        bool tx_stream_end() {
+            bool success = true;
+            uint_fast64_t deadline = hwlib::now_us() + tx_stream_timeout_us;
+            while ((fifo_status() & NRF_FIFO_STATUS::TX_EMPTY) == 0) {
+                if ((last_status & NRF_STATUS::MAX_RT) != 0 || hwlib::now_us() > deadline) {
+                    tx_flush();
+                    success = false;
+                    break;
+                }
+            }
+            pin_write(ce, false);
+            write_register<NRF_REGISTER::NRF_STATUS>(uint8_t(NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT));
+            tx_stream_free_slots = 0;
+            return success;
+        }
+
+        /**
+         * \brief Transmit a series of equally sized payloads, keeping the TX FIFO filled
+         *
+         * @param data Memory location of the payloads, stored back to back
+         * @param count Amount of payloads
+         * @param size Size of each payload
+         * @param noack If True, the payloads are written with NO_ACK enabled
+         * @return True if all payloads were sent
+         */
+        bool tx_burst(const uint8_t *data, size_t count, const uint8_t &size, bool noack = false) {
+            tx_stream_begin();
+            for (size_t i = 0; i < count; i++) {
+                if (!tx_stream_write(data + i * size, size, noack)) {
+                    break;
+                }
+            }
+            return tx_stream_end();
+        }
+
 
         /**
          * \brief enable or disable auto acknowledgement for a given pipe
@@ -418,13 +1128,13 @@ namespace nrf24l01 {
          */
         void rx_auto_acknowledgement(const uint8_t &pipe, const bool &value) {
             uint8_t full_register;
-            read_register(NRF_REGISTER::EN_AA, &full_register);
+            read_register<NRF_REGISTER::EN_AA>(&full_register);
             if (value) {
                 full_register |= 1 << pipe;
             } else {
                 full_register &= ~(1 << pipe);
             }
-            write_register(NRF_REGISTER::EN_AA, &full_register);
+            write_register<NRF_REGISTER::EN_AA>(&full_register);
         }
 
         /**
@@ -432,7 +1142,7 @@ namespace nrf24l01 {
          * @param value True of AutoAck needs to be enabled
          */
         void rx_auto_acknowledgement(const bool &value) {
-            write_register(NRF_REGISTER::EN_AA, uint8_t(value ? 0x3F : 0x00));
+            write_register<NRF_REGISTER::EN_AA>(uint8_t(value ? 0x3F : 0x00));
         }
 
         /**
@@ -443,13 +1153,13 @@ namespace nrf24l01 {
          */
         void rx_enabled(const uint8_t &pipe, const bool &value) {
             uint8_t full_register;
-            read_register(NRF_REGISTER::EN_RXADDR, &full_register);
+            read_register<NRF_REGISTER::EN_RXADDR>(&full_register);
             if (value) {
                 full_register |= 1 << pipe;
             } else {
                 full_register &= ~(1 << pipe);
             }
-            write_register(NRF_REGISTER::EN_RXADDR, &full_register);
+            write_register<NRF_REGISTER::EN_RXADDR>(&full_register);
         }
 
         /**
@@ -458,43 +1168,44 @@ namespace nrf24l01 {
          * @param value True if the pipe needs to be enabled
          */
         void rx_enabled(const bool &value) {
-            write_register(NRF_REGISTER::EN_RXADDR, uint8_t(value ? 0x3F : 0x00));
+            write_register<NRF_REGISTER::EN_RXADDR>(uint8_t(value ? 0x3F : 0x00));
         }
 
         /**
          * \brief Retrieve the address for a given rx pipe
          *
-         * Adds the first 4 bytes from pipe 1 for all pipe numbers between 2 and 5.
+         * Adds all but the last byte from pipe 1 for all pipe numbers between 2 and 5.
          * @param pipe Number of the pipe to get address for
          * @return The full pipe address
          */
         address rx_get_address(const uint8_t &pipe) {
+            uint8_t data[address::MAX_WIDTH] = {0};
             if (pipe > 1) {
-                address base_address;
                 uint8_t end;
-                read_register(NRF_REGISTER::RX_ADDR_P1, base_address.address_bytes);
+                read_register<NRF_REGISTER::RX_ADDR_P1>(data);
                 read_register(NRF_REGISTER::RX_ADDR_P0 + pipe, &end);
-                return {base_address, end};
+                return {address::from_bytes(data, address_size), end};
             }
 
-            uint8_t address[5] = {0};
-            read_register(NRF_REGISTER::RX_ADDR_P0 + pipe, address, true);
-            return {address};
+            read_register(NRF_REGISTER::RX_ADDR_P0 + pipe, data);
+            return address::from_bytes(data, address_size);
         }
 
         /**
          * \brief Set the address for a given rx pipe
          *
-         * Note that for pipes 2-5, the first 4 bytes of the address are ignore.
+         * Note that for pipes 2-5, only the last byte of the address is used.
          * Set the address for pipe 1 aswell to change these.
          * @param pipe Pipe number
          * @param address New address for the pipe
          */
-        void rx_set_address(const uint8_t &pipe, address &address) {
+        void rx_set_address(const uint8_t &pipe, const address &address) {
             if (pipe > 1) {
-                write_register(NRF_REGISTER::RX_ADDR_P0 + pipe, address.address_bytes + 4, true);
+                write_register(NRF_REGISTER::RX_ADDR_P0 + pipe, address.last_byte());
             } else {
-                write_register(NRF_REGISTER::RX_ADDR_P0 + pipe, address.address_bytes, true);
+                uint8_t data[address::MAX_WIDTH];
+                address.to_bytes(data);
+                write_register(NRF_REGISTER::RX_ADDR_P0 + pipe, data);
             }
         }
 
@@ -541,13 +1252,13 @@ namespace nrf24l01 {
          */
         void rx_set_dynamic_payload_length(const uint8_t &pipe, const bool &enabled) {
             uint8_t previousVal;
-            read_register(NRF_REGISTER::DYNPD, &previousVal);
+            read_register<NRF_REGISTER::DYNPD>(&previousVal);
             if (enabled) {
                 previousVal |= 1u << pipe;
             } else {
                 previousVal &= ~(1u << pipe);
             }
-            write_register(NRF_REGISTER::DYNPD, &previousVal);
+            write_register<NRF_REGISTER::DYNPD>(&previousVal);
         }
 
         /**
@@ -556,11 +1267,97 @@ namespace nrf24l01 {
          * @param enabled True if DPL needs to be enabled
          */
         void rx_set_dynamic_payload_length(const bool &enabled) {
-            write_register(NRF_REGISTER::DYNPD, uint8_t(enabled ? 0x3F : 0x00));
+            write_register<NRF_REGISTER::DYNPD>(uint8_t(enabled ? 0x3F : 0x00));
+        }
+
+        /**
+         * \brief Enable or disable features in the FEATURE register
+         *
+         * Feature bits can be found in NRF_FEATURE
+         * @param features Bitmask of the features to change
+         * @param enabled True if the features need to be enabled
+         */
+        void feature(const uint8_t &features, const bool &enabled) {
+            uint8_t previousVal;
+            read_register<NRF_REGISTER::FEATURE>(&previousVal);
+            if (enabled) {
+                previousVal |= features;
+            } else {
+                previousVal &= ~features;
+            }
+            write_register<NRF_REGISTER::FEATURE>(&previousVal);
+        }
+
+//////////////////////////////////////////////////////////////////////////////  ACK Payload Functions
+        /**
+         * \brief Enable or disable ACK payloads
+         *
+         * ACK payloads need Dynamic Payload Length, so enabling them also enables DPL for all pipes.
+         * This needs to be done on both the PTX and the PRX side.
+         * Disabling leaves DPL enabled.
+         * @param enabled True if ACK payloads need to be enabled
+         */
+        void ack_payload_enabled(const bool &enabled) {
+            if (enabled) {
+                feature(NRF_FEATURE::EN_ACK_PAY | NRF_FEATURE::EN_DPL, true);
+                rx_set_dynamic_payload_length(true);
+            } else {
+                feature(NRF_FEATURE::EN_ACK_PAY, false);
+            }
+        }
+
+        /**
+         * \brief Queue a payload to be sent along with the next acknowledgement on a pipe (PRX side)
+         *
+         * ACK payloads share the 3 slot TX FIFO. The status byte clocked out with the command tells if the FIFO was full,
+         * in which case the payload is not stored.
+         * Queued ACK payloads can be removed with nrf24l01plus::tx_flush().
+         * @param pipe Pipe number to send the payload on
+         * @param data Memory location to write data from
+         * @param size Size of the payload (1-32)
+         * @return False if the TX FIFO was full
+         */
+        bool rx_write_ack_payload(const uint8_t &pipe, const uint8_t *data, const uint8_t &size) {
+            send_command(NRF_INSTRUCTION::W_ACK_PAYLOAD | (pipe & uint8_t(0x07)), data, size, nullptr);
+            return (last_status & NRF_STATUS::TX_FULL) == 0;
+        }
+
+        /**
+         * \brief Queue a payload to be sent along with the next acknowledgement on a pipe (PRX side)
+         *
+         * @tparam n Size of the payload
+         * @param pipe Pipe number to send the payload on
+         * @param out Array of data to write
+         * @return False if the TX FIFO was full
+         */
+        template<size_t n>
+        bool rx_write_ack_payload(const uint8_t &pipe, const std::array<uint8_t, n> &out) {
+            return rx_write_ack_payload(pipe, out.begin(), n);
+        }
+
+        /**
+         * \brief Read an ACK payload that arrived with an acknowledgement (PTX side)
+         *
+         * ACK payloads end up in the RX FIFO on pipe 0, RX_DR is set together with TX_DS when one arrives.
+         * @param data Memory location to read the payload into, at least 32 bytes
+         * @return Size of the payload, or 0 if no payload was available
+         */
+        uint8_t tx_read_ack_payload(uint8_t *data) {
+            return rx_read_next(data);
         }
 
     };
 
+    /**
+     * \brief NRF24L01+ driver on the abstract spi::spi_base_bus and hwlib::pin_out interfaces
+     */
+    using nrf24l01plus = basic_nrf24l01plus<>;
+
+    /**
+     * \brief NRF24L01+ driver with the shadow register cache compiled in, see basic_nrf24l01plus::cache(bool)
+     */
+    using cached_nrf24l01plus = basic_nrf24l01plus<spi::spi_base_bus, hwlib::pin_out, true>;
+
     /**
      * @}
      */
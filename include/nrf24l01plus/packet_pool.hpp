@@ -0,0 +1,163 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_PACKET_POOL_HPP
+#define PROJECT_NRF24L01_PACKET_POOL_HPP
+
+#include <atomic>
+#include <nrf24l01plus/nrf24l01plus.hpp>
+#include <nrf24l01plus/spsc_ring.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief One payload, with the metadata of its reception
+     */
+    struct packet {
+        //! Payload data
+        uint8_t data[32];
+        //! Pipe the payload was received on, or should be sent on
+        uint8_t pipe;
+        //! Amount of valid bytes in data
+        uint8_t length;
+        //! Time of reception (hwlib::now_us(), truncated to 32 bits)
+        uint32_t timestamp;
+    };
+
+    /**
+     * \brief Fixed size pool of packets
+     *
+     * Packets are handed out and taken back through a lock-free ring, so one side (for example an interrupt routine)
+     * can allocate while the other side (the main loop) releases. The ring has a single producer, so the allocating side
+     * must not call release(); it hands back a packet it didn't use with put_back().
+     * @tparam N Amount of packets in the pool, needs to be a power of two
+     */
+    template<size_t N>
+    class packet_pool {
+        packet slots[N] = {};
+        spsc_ring<packet *, N> free_slots;
+        std::atomic<packet *> spare{nullptr};
+
+    public:
+        /**
+         * \brief Create a pool with all packets free
+         */
+        packet_pool() {
+            for (auto &slot : slots) {
+                free_slots.push(&slot);
+            }
+        }
+
+        packet_pool(const packet_pool &) = delete;
+
+        packet_pool &operator=(const packet_pool &) = delete;
+
+        /**
+         * \brief Take a packet out of the pool
+         * @return The packet, or nullptr if all packets are in use
+         */
+        packet *allocate() {
+            packet *result = spare.exchange(nullptr, std::memory_order_relaxed);
+            if (result == nullptr) {
+                free_slots.pop(result);
+            }
+            return result;
+        }
+
+        /**
+         * \brief Return a packet to the pool, from the side that consumes the packets
+         * @param p Packet that was allocated from this pool
+         */
+        void release(packet *p) {
+            free_slots.push(p);
+        }
+
+        /**
+         * \brief Hand back an unused packet, from the allocating side
+         *
+         * The packet is kept aside and handed out again by the next allocate(). Only one packet can be kept aside,
+         * so a packet needs to be put back before the next one is allocated.
+         * @param p Packet that was just allocated from this pool
+         */
+        void put_back(packet *p) {
+            spare.store(p, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Amount of free packets
+         */
+        size_t available() const {
+            return free_slots.size() + (spare.load(std::memory_order_relaxed) != nullptr ? 1 : 0);
+        }
+    };
+
+    /**
+     * \brief Queue of packets between the receiving side and the application
+     * @tparam N Capacity, needs to be a power of two
+     */
+    template<size_t N>
+    using packet_queue = spsc_ring<packet *, N>;
+
+    /**
+     * \brief Read every payload in the RX FIFO directly into packets from a pool, and queue them
+     *
+     * Works like nrf24l01plus::rx_drain(uint8_t*, F&&), but without copying payloads out of an intermediate buffer.
+     * When the pool or the queue runs out of space, the remaining payloads are left in the RX FIFO and RX_DR stays set,
+     * so they are picked up by the next call. Packets are only allocated here, never released: a packet that ends up unused
+     * is reused for the next payload, and put back into the pool when the FIFO is empty.
+     * @tparam N Size of the pool
+     * @tparam Q Capacity of the queue
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     * @param nrf Module to read from
+     * @param pool Pool to take packets from
+     * @param queue Queue to add the received packets to
+     * @return Amount of packets queued
+     */
+    template<size_t N, size_t Q, typename Radio>
+    uint8_t rx_drain_into(Radio &nrf, packet_pool<N> &pool, packet_queue<Q> &queue) {
+        uint8_t count = 0;
+        uint8_t dynpd;
+        nrf.read_register(NRF_REGISTER::DYNPD, &dynpd);
+        packet *p = nullptr;
+        while (!queue.full()) {
+            if (p == nullptr) {
+                p = pool.allocate();
+                if (p == nullptr) {
+                    break;
+                }
+            }
+            p->length = nrf.rx_read_next(p->data, dynpd);
+            p->pipe = nrf.rx_pipe();
+            if (p->pipe > 5 || p->length == 0) {
+                if (p->pipe > 5 && !nrf.rx_clear_data_ready()) {
+                    break;
+                }
+                continue;
+            }
+            p->timestamp = static_cast<uint32_t>(hwlib::now_us());
+            queue.push(p);
+            p = nullptr;
+            count++;
+        }
+        if (p != nullptr) {
+            pool.put_back(p);
+        }
+        return count;
+    }
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_PACKET_POOL_HPP
@@ -0,0 +1,260 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_RATE_CONTROL_HPP
+#define PROJECT_NRF24L01_RATE_CONTROL_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Combination of data rate and output power
+     */
+    struct rate_step {
+        //! One of the NRF_DATA_RATE values
+        uint8_t rate;
+        //! One of the NRF_TX_POWER values
+        uint8_t power;
+    };
+
+    /**
+     * \brief Interface for objects that coordinate data rate changes with the other end of the link
+     */
+    class rate_change_listener {
+    public:
+        /**
+         * \brief Called before the controller switches to another data rate
+         *
+         * The receiver needs to switch to the same rate, so this is the moment to tell it, for example in a payload.
+         * @param next The setting the controller wants to switch to
+         * @return True if the change can go ahead, false to stay on the current setting for now
+         */
+        virtual bool rate_changing(const rate_step &next) = 0;
+    };
+
+    /**
+     * \brief Data rate and output power controller, for the transmitting end of a link
+     *
+     * Steps through a ladder of settings, from 2 Mbps at the lowest power (fast and efficient, for near nodes)
+     * up to 250 kbps at full power (the longest range). Every evaluation_window transmissions, it steps up the ladder
+     * when too many packets were lost or needed too many retries. When all packets in a window were lost,
+     * it jumps straight to the top, so a far node falls back instead of going silent.
+     * It only steps down again after improve_windows windows in a row without losses and with few retries.
+     *
+     * Output power only matters to the transmitter, but the receiver needs to use the same data rate,
+     * so data rate changes are announced through a rate_change_listener first.
+     * Use rate_follower on the receiving end to find the transmitter again when an announcement got lost.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class rate_controller {
+    public:
+        //! Amount of settings in the ladder
+        static constexpr const uint8_t STEP_COUNT = 6;
+        //! All settings, from most efficient to most robust
+        static constexpr const rate_step STEPS[STEP_COUNT] = {
+                {NRF_DATA_RATE::RATE_2MBPS,   NRF_TX_POWER::POWER_MIN_18DBM},
+                {NRF_DATA_RATE::RATE_2MBPS,   NRF_TX_POWER::POWER_MIN_12DBM},
+                {NRF_DATA_RATE::RATE_2MBPS,   NRF_TX_POWER::POWER_MIN_6DBM},
+                {NRF_DATA_RATE::RATE_2MBPS,   NRF_TX_POWER::POWER_0DBM},
+                {NRF_DATA_RATE::RATE_1MBPS,   NRF_TX_POWER::POWER_0DBM},
+                {NRF_DATA_RATE::RATE_250KBPS, NRF_TX_POWER::POWER_0DBM}
+        };
+
+        //! Amount of transmissions between evaluations
+        uint8_t evaluation_window = 16;
+        //! Loss percentage in a window at which the controller steps up
+        uint8_t degrade_loss = 25;
+        //! Average retransmissions (in 1/16ths) in a window at which the controller steps up
+        uint16_t degrade_retries = 3 << 4;
+        //! Average retransmissions (in 1/16ths) in a window below which the window counts as good
+        uint16_t improve_retries = 1 << 3;
+        //! Amount of good windows in a row needed before stepping down
+        uint8_t improve_windows = 4;
+
+    private:
+        Radio &nrf;
+        rate_change_listener *listener;
+        uint8_t current;
+        uint8_t window_sent = 0;
+        uint8_t window_lost = 0;
+        uint16_t window_retries = 0;
+        uint8_t good_windows = 0;
+
+    public:
+        /**
+         * \brief Create a controller
+         * @param nrf Module to configure
+         * @param initial_step Index in STEPS to start at
+         * @param listener Listener to announce data rate changes to, can be nullptr if both ends are changed otherwise
+         */
+        explicit rate_controller(Radio &nrf, uint8_t initial_step = 0, rate_change_listener *listener = nullptr) :
+                nrf(nrf), listener(listener), current(initial_step < STEP_COUNT ? initial_step : STEP_COUNT - 1) {}
+
+        /**
+         * \brief Write the current setting to the module
+         */
+        void apply() {
+            nrf.data_rate(STEPS[current].rate);
+            nrf.tx_power(STEPS[current].power);
+            if (STEPS[current].rate == NRF_DATA_RATE::RATE_250KBPS) {
+                // An acknowledgement at 250kbps does not fit in the shortest retransmit delay
+                uint8_t retr;
+                nrf.read_register(NRF_REGISTER::SETUP_RETR, &retr);
+                if ((retr >> 4) == 0) {
+                    nrf.write_register(NRF_REGISTER::SETUP_RETR, retr | 0x10);
+                }
+            }
+        }
+
+        /**
+         * \brief Record the result of a transmission, for example from a tx_completion_listener
+         * @param success False if the transmission reached MAX_RT
+         * @param retries Amount of retransmissions (ARC_CNT)
+         */
+        void record(bool success, uint8_t retries) {
+            window_sent++;
+            if (!success) {
+                window_lost++;
+            }
+            window_retries += retries & NRF_OBSERVE_TX::TX_ARC_CNT;
+            if (window_sent >= evaluation_window) {
+                evaluate();
+            }
+        }
+
+        /**
+         * \brief Record the result of a transmission, reading the retransmission count from OBSERVE_TX
+         * @param success False if the transmission reached MAX_RT
+         */
+        void record(bool success) {
+            record(success, nrf.tx_retransmit_count());
+        }
+
+        /**
+         * \brief Index of the current setting in STEPS
+         */
+        uint8_t step() const {
+            return current;
+        }
+
+        /**
+         * \brief The current setting
+         */
+        const rate_step &setting() const {
+            return STEPS[current];
+        }
+
+    private:
+        void evaluate() {
+            uint16_t average = (window_retries << 4) / window_sent;
+            if (window_lost == window_sent) {
+                change(STEP_COUNT - 1);
+            } else if (uint16_t(window_lost) * 100 >= uint16_t(degrade_loss) * window_sent ||
+                       average >= degrade_retries) {
+                change(current + 1 < STEP_COUNT ? current + 1 : current);
+            } else if (window_lost == 0 && average < improve_retries) {
+                if (++good_windows >= improve_windows && current > 0) {
+                    change(current - 1);
+                }
+            } else {
+                good_windows = 0;
+            }
+            window_sent = 0;
+            window_lost = 0;
+            window_retries = 0;
+        }
+
+        void change(uint8_t next) {
+            good_windows = 0;
+            if (next == current) {
+                return;
+            }
+            if (STEPS[next].rate != STEPS[current].rate && listener != nullptr &&
+                !listener->rate_changing(STEPS[next])) {
+                return;
+            }
+            current = next;
+            apply();
+        }
+    };
+
+    /**
+     * \brief Data rate search for the receiving end of a link controlled by a rate_controller
+     *
+     * When nothing was received for a while, the transmitter probably switched data rates without the receiver
+     * noticing, so the receiver tries the next rate.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<typename Radio = nrf24l01plus>
+    class rate_follower {
+        static constexpr const uint8_t RATES[3] = {
+                NRF_DATA_RATE::RATE_2MBPS, NRF_DATA_RATE::RATE_1MBPS, NRF_DATA_RATE::RATE_250KBPS
+        };
+
+        Radio &nrf;
+        uint_fast64_t silence_us;
+        uint_fast64_t last_heard;
+
+    public:
+        /**
+         * \brief Create a follower
+         * @param nrf Module to configure
+         * @param silence_us Time without receptions after which the next data rate is tried
+         */
+        explicit rate_follower(Radio &nrf, uint_fast64_t silence_us = 100000) :
+                nrf(nrf), silence_us(silence_us), last_heard(hwlib::now_us()) {}
+
+        /**
+         * \brief Report that something was received
+         */
+        void heard() {
+            last_heard = hwlib::now_us();
+        }
+
+        /**
+         * \brief Switch to the next data rate when the receiver was silent for too long, should be called regularly
+         * @return True if the data rate was changed
+         */
+        bool poll() {
+            uint_fast64_t now = hwlib::now_us();
+            if (now - last_heard < silence_us) {
+                return false;
+            }
+            last_heard = now;
+            uint8_t current = nrf.data_rate();
+            uint8_t index = 0;
+            while (index < 2 && RATES[index] != current) {
+                index++;
+            }
+            index = (index + 1) % 3;
+
+            bool receiving = nrf.get_mode() == nrf.MODE_PRX;
+            if (receiving) {
+                nrf.pin_write(nrf.ce, false);
+            }
+            nrf.data_rate(RATES[index]);
+            if (receiving) {
+                nrf.pin_write(nrf.ce, true);
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_RATE_CONTROL_HPP
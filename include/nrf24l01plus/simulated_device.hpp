@@ -0,0 +1,691 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_SIMULATED_DEVICE_HPP
+#define PROJECT_NRF24L01_SIMULATED_DEVICE_HPP
+
+#include <hwlib.hpp>
+#include <spi/bus_base.hpp>
+#include <nrf24l01plus/definitions.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    class simulated_nrf24l01plus;
+
+    /**
+     * \brief Shared "air" between simulated NRF24L01+ devices
+     *
+     * Every packet one attached device transmits is offered to all other attached devices.
+     * Interference can be simulated per channel, as a percentage of packets that get lost.
+     */
+    class simulated_medium {
+    public:
+        //! Maximum amount of devices that can share one medium
+        static constexpr const size_t MAX_DEVICES = 8;
+
+        //! Devices attached to this medium
+        simulated_nrf24l01plus *devices[MAX_DEVICES] = {nullptr};
+        //! Amount of attached devices
+        size_t device_count = 0;
+        //! Percentage of packets lost per channel. A nonzero value also makes the RPD register report a carrier
+        uint8_t channel_loss[126] = {0};
+        //! State of the pseudo random generator used for packet loss, fixed so simulations are reproducible
+        uint32_t random_state = 0x2545F491;
+
+        /**
+         * \brief Attach a device to this medium
+         * @param device The device to attach
+         */
+        void attach(simulated_nrf24l01plus &device);
+
+        /**
+         * \brief Decide if a packet on a channel gets lost to interference
+         * @param channel The channel the packet is sent on
+         * @return True if the packet is lost
+         */
+        bool lose_packet(uint8_t channel) {
+            if (channel >= 126 || channel_loss[channel] == 0) {
+                return false;
+            }
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 17;
+            random_state ^= random_state << 5;
+            return random_state % 100 < channel_loss[channel];
+        }
+    };
+
+    /**
+     * \brief Software model of an NRF24L01+ tranceiver, for testing and benchmarking the driver without hardware
+     *
+     * The model implements spi::spi_base_bus, and offers CSN, CE and IRQ pins. It can be passed directly into the
+     * nrf24l01plus constructor: `nrf24l01plus nrf(device, device.csn, device.ce);`.
+     * Implemented are the full register map, 3 level TX and RX FIFOs, STATUS flags, CE/CSN semantics, power up and
+     * settling delays, auto acknowledgement with retransmission, Dynamic Payload Length, NOACK, ACK payloads and payload reuse.
+     * Timing is approximated using the air time of each packet, based on the configured data rate.
+     *
+     * Packets are only exchanged with other devices on the same simulated_medium.
+     */
+    class simulated_nrf24l01plus : public spi::spi_base_bus {
+    public:
+        /**
+         * \brief Output pin of the simulated device (CSN or CE)
+         */
+        class pin : public hwlib::pin_out {
+            simulated_nrf24l01plus &device;
+            bool is_csn;
+        public:
+            /**
+             * \brief Create a pin for a simulated device
+             * @param device The device this pin belongs to
+             * @param is_csn True for the CSN pin, false for the CE pin
+             */
+            pin(simulated_nrf24l01plus &device, bool is_csn) : device(device), is_csn(is_csn) {}
+
+            void write(bool v) override {
+                if (is_csn) {
+                    device.csn_write(v);
+                } else {
+                    device.ce_write(v);
+                }
+            }
+
+            void flush() override {}
+        };
+
+        /**
+         * \brief IRQ pin of the simulated device (active low)
+         */
+        class irq_pin : public hwlib::pin_in {
+            simulated_nrf24l01plus &device;
+        public:
+            /**
+             * \brief Create the IRQ pin for a simulated device
+             * @param device The device this pin belongs to
+             */
+            explicit irq_pin(simulated_nrf24l01plus &device) : device(device) {}
+
+            bool read() override {
+                device.update();
+                return device.irq_level();
+            }
+
+            void refresh() override {}
+        };
+
+        /**
+         * \brief Payload in one of the simulated FIFO's
+         */
+        struct fifo_entry {
+            //! Payload data
+            uint8_t data[32];
+            //! Payload size
+            uint8_t size;
+            //! Pipe the payload was received on, or the pipe an ACK payload is meant for
+            uint8_t pipe;
+            //! True if the payload was written with W_TX_PAYLOAD_NO_ACK
+            bool noack;
+        };
+
+        /**
+         * \brief Counters for everything that happened on the simulated device
+         */
+        struct statistics {
+            //! SPI transactions (CSN low periods)
+            uint32_t spi_transactions;
+            //! SPI bytes exchanged, including command bytes
+            uint32_t spi_bytes;
+            //! Payloads sent successfully (TX_DS)
+            uint32_t packets_sent;
+            //! Payloads received into the RX FIFO
+            uint32_t packets_received;
+            //! Payloads given up on after the maximum amount of retransmissions (MAX_RT)
+            uint32_t packets_lost;
+            //! Retransmissions done
+            uint32_t retransmissions;
+            //! Microseconds spent on air
+            uint32_t air_time_us;
+        };
+
+        //! Chip select pin, pass this into the nrf24l01plus constructor
+        pin csn;
+        //! Chip enable pin, pass this into the nrf24l01plus constructor
+        pin ce;
+        //! Interrupt pin
+        irq_pin irq;
+        //! Statistics, can be reset at any time
+        statistics stats = {};
+        //! Time source in microseconds, can be replaced to run the simulation on a virtual clock
+        uint_fast64_t (*clock)() = hwlib::now_us;
+        //! Medium this device sends and receives on
+        simulated_medium *medium = nullptr;
+
+        /**
+         * \brief Create a simulated device, in its power on reset state
+         */
+        simulated_nrf24l01plus() : csn(*this, true), ce(*this, false), irq(*this) {
+            reset();
+        }
+
+        simulated_nrf24l01plus(const simulated_nrf24l01plus &) = delete;
+
+        simulated_nrf24l01plus &operator=(const simulated_nrf24l01plus &) = delete;
+
+        /**
+         * \brief Put all registers and FIFO's in their power on reset state
+         */
+        void reset() {
+            for (auto &reg : registers) {
+                for (auto &byte : reg) {
+                    byte = 0;
+                }
+            }
+            registers[NRF_REGISTER::CONFIG][0] = 0x08;
+            registers[NRF_REGISTER::EN_AA][0] = 0x3F;
+            registers[NRF_REGISTER::EN_RXADDR][0] = 0x03;
+            registers[NRF_REGISTER::SETUP_AW][0] = 0x03;
+            registers[NRF_REGISTER::SETUP_RETR][0] = 0x03;
+            registers[NRF_REGISTER::RF_CH][0] = 0x02;
+            registers[NRF_REGISTER::RF_SETUP][0] = 0x0E;
+            for (uint8_t i = 0; i < 5; i++) {
+                registers[NRF_REGISTER::RX_ADDR_P0][i] = 0xE7;
+                registers[NRF_REGISTER::RX_ADDR_P1][i] = 0xC2;
+                registers[NRF_REGISTER::TX_ADDR][i] = 0xE7;
+            }
+            registers[NRF_REGISTER::RX_ADDR_P2][0] = 0xC3;
+            registers[NRF_REGISTER::RX_ADDR_P3][0] = 0xC4;
+            registers[NRF_REGISTER::RX_ADDR_P4][0] = 0xC5;
+            registers[NRF_REGISTER::RX_ADDR_P5][0] = 0xC6;
+
+            flags = 0;
+            tx_count = 0;
+            rx_count = 0;
+            reuse = false;
+            lost_count = 0;
+            retransmit_count = 0;
+            tx_active = false;
+            ce_pulse_pending = false;
+            powered_at = 0;
+            tx_earliest = 0;
+            rx_ready_at = 0;
+        }
+
+        /**
+         * \brief Bring the simulation up to date with the clock
+         *
+         * Finishes transmissions whose air time has passed and starts new ones.
+         * This is called on every pin change and SPI byte, so normally it doesn't need to be called manually.
+         */
+        void update() {
+            uint_fast64_t now = clock();
+            while (true) {
+                if (tx_active) {
+                    if (now < attempt_end) {
+                        return;
+                    }
+                    finish_attempt();
+                    continue;
+                }
+                if (!tx_can_start()) {
+                    return;
+                }
+                uint_fast64_t start = tx_earliest > powered_at ? tx_earliest : powered_at;
+                if (now < start) {
+                    return;
+                }
+                start_attempt(start);
+            }
+        }
+
+        /**
+         * \brief Level of the (active low) IRQ pin
+         * @return False if an unmasked interrupt flag is set
+         */
+        bool irq_level() const {
+            return (flags & ~registers[NRF_REGISTER::CONFIG][0] & 0x70) == 0;
+        }
+
+        /**
+         * \brief Direct access to a register, bypassing SPI
+         * @param address Register address
+         * @param index Byte index (LSByte first)
+         * @return The register byte
+         */
+        uint8_t peek_register(uint8_t address, uint8_t index = 0) {
+            return read_register_byte(address, index);
+        }
+
+        /**
+         * \brief Amount of payloads in the TX FIFO
+         */
+        uint8_t tx_fifo_count() const {
+            return tx_count;
+        }
+
+        /**
+         * \brief Amount of payloads in the RX FIFO
+         */
+        uint8_t rx_fifo_count() const {
+            return rx_count;
+        }
+
+        /**
+         * \brief Offer a packet from another device to this device
+         *
+         * Used by simulated_medium, this checks if this device is listening on the packet's channel, data rate and address.
+         * @param sender The transmitting device
+         * @param packet The packet that was sent
+         * @param ack_expected True if the sender waits for an acknowledgement
+         * @param ack_payload Filled with an ACK payload, if one is sent back
+         * @param has_ack_payload Set to true if an ACK payload was sent back
+         * @return True if the packet was received and (when expected) acknowledged
+         */
+        bool receive(simulated_nrf24l01plus &sender, const fifo_entry &packet, bool ack_expected,
+                     fifo_entry &ack_payload, bool &has_ack_payload) {
+            if (!powered() || (config() & NRF_CONFIG::CONFIG_PRIM_RX) == 0 || !ce_high ||
+                sender.clock() < rx_ready_at || channel() != sender.channel() || data_rate() != sender.data_rate() ||
+                address_width() != sender.address_width()) {
+                return false;
+            }
+
+            uint8_t pipe = matching_pipe(sender.registers[NRF_REGISTER::TX_ADDR]);
+            if (pipe > 5) {
+                return false;
+            }
+            if (rx_count == 3) {
+                return false;
+            }
+            if (!dynamic_payload_length(pipe) && registers[NRF_REGISTER::RX_PW_P0 + pipe][0] != packet.size) {
+                return false;
+            }
+
+            fifo_entry &received = rx_fifo[rx_count++];
+            received = packet;
+            received.pipe = pipe;
+            flags |= NRF_STATUS::RX_DR;
+            stats.packets_received++;
+
+            has_ack_payload = false;
+            if (!ack_expected || (registers[NRF_REGISTER::EN_AA][0] & (1u << pipe)) == 0) {
+                return !ack_expected;
+            }
+            if ((registers[NRF_REGISTER::FEATURE][0] & NRF_FEATURE::EN_ACK_PAY) != 0) {
+                for (uint8_t i = 0; i < tx_count; i++) {
+                    if (tx_fifo[i].pipe == pipe) {
+                        ack_payload = tx_fifo[i];
+                        has_ack_payload = true;
+                        remove_tx(i);
+                        flags |= NRF_STATUS::TX_DS;
+                        break;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void write_read(const size_t &n, const uint8_t *data_out, uint8_t *data_in) override {
+            for (size_t i = 0; i < n; i++) {
+                uint8_t in = shift(data_out == nullptr ? NRF_INSTRUCTION::RF24_NOP : data_out[i]);
+                if (data_in != nullptr) {
+                    data_in[i] = in;
+                }
+            }
+        }
+
+        /**
+         * \brief Exchange bytes with the simulated device, starting at the end of the buffers
+         * @param n Amount of bytes
+         * @param data_out Bytes to send
+         * @param data_in Buffer for the received bytes
+         */
+        void write_read_reverse(const size_t &n, const uint8_t *data_out, uint8_t *data_in) override {
+            for (size_t i = n; i > 0; i--) {
+                uint8_t in = shift(data_out == nullptr ? NRF_INSTRUCTION::RF24_NOP : data_out[i - 1]);
+                if (data_in != nullptr) {
+                    data_in[i - 1] = in;
+                }
+            }
+        }
+
+    private:
+        uint8_t registers[NRF_REGISTER::FEATURE + 1][5] = {{0}};
+        uint8_t flags = 0;
+        fifo_entry tx_fifo[3] = {};
+        fifo_entry rx_fifo[3] = {};
+        uint8_t tx_count = 0;
+        uint8_t rx_count = 0;
+        bool reuse = false;
+        uint8_t lost_count = 0;
+        uint8_t retransmit_count = 0;
+
+        bool selected = false;
+        bool ce_high = false;
+        bool ce_pulse_pending = false;
+        uint8_t command = 0;
+        uint8_t byte_index = 0;
+        fifo_entry pending = {};
+
+        bool tx_active = false;
+        uint_fast64_t attempt_end = 0;
+        uint_fast64_t powered_at = 0;
+        uint_fast64_t tx_earliest = 0;
+        uint_fast64_t rx_ready_at = 0;
+
+        uint8_t config() const {
+            return registers[NRF_REGISTER::CONFIG][0];
+        }
+
+        bool powered() const {
+            return (config() & NRF_CONFIG::CONFIG_PWR_UP) != 0;
+        }
+
+        uint8_t channel() const {
+            return registers[NRF_REGISTER::RF_CH][0];
+        }
+
+        uint16_t data_rate() const {
+            uint8_t setup = registers[NRF_REGISTER::RF_SETUP][0];
+            if ((setup & NRF_RF_SETUP::RF_DR_LOW) != 0) {
+                return 250;
+            }
+            return (setup & NRF_RF_SETUP::RF_DR_HIGH) != 0 ? 2000 : 1000;
+        }
+
+        uint8_t address_width() const {
+            uint8_t aw = registers[NRF_REGISTER::SETUP_AW][0] & 0x03;
+            return aw == 0 ? 5 : aw + 2;
+        }
+
+        bool dynamic_payload_length(uint8_t pipe) const {
+            return (registers[NRF_REGISTER::FEATURE][0] & NRF_FEATURE::EN_DPL) != 0 &&
+                   (registers[NRF_REGISTER::DYNPD][0] & (1u << pipe)) != 0;
+        }
+
+        uint8_t matching_pipe(const uint8_t *tx_address) const {
+            uint8_t width = address_width();
+            for (uint8_t pipe = 0; pipe < 6; pipe++) {
+                if ((registers[NRF_REGISTER::EN_RXADDR][0] & (1u << pipe)) == 0) {
+                    continue;
+                }
+                const uint8_t *base = registers[pipe == 0 ? NRF_REGISTER::RX_ADDR_P0 : NRF_REGISTER::RX_ADDR_P1];
+                bool match = tx_address[0] == (pipe > 1 ? registers[NRF_REGISTER::RX_ADDR_P0 + pipe][0] : base[0]);
+                for (uint8_t i = 1; i < width; i++) {
+                    match &= tx_address[i] == base[i];
+                }
+                if (match) {
+                    return pipe;
+                }
+            }
+            return 7;
+        }
+
+        uint32_t air_time_us(uint8_t payload_size) const {
+            uint32_t bits = (data_rate() == 2000 ? 16 : 8) + address_width() * 8 + 9 + payload_size * 8;
+            if ((config() & NRF_CONFIG::CONFIG_EN_CRC) != 0 || registers[NRF_REGISTER::EN_AA][0] != 0) {
+                bits += (config() & NRF_CONFIG::CONFIG_CRCO) != 0 ? 16 : 8;
+            }
+            return bits * 1000 / data_rate();
+        }
+
+        bool ack_expected(const fifo_entry &packet) const {
+            bool noack = packet.noack && (registers[NRF_REGISTER::FEATURE][0] & NRF_FEATURE::EN_DYN_ACK) != 0;
+            return !noack && (registers[NRF_REGISTER::EN_AA][0] & NRF_EN_AA::ENAA_P0) != 0;
+        }
+
+        uint32_t attempt_time_us(const fifo_entry &packet) const {
+            uint32_t time = air_time_us(packet.size);
+            if (ack_expected(packet)) {
+                time += 130 + air_time_us(0);
+            }
+            return time;
+        }
+
+        bool tx_can_start() const {
+            return powered() && (config() & NRF_CONFIG::CONFIG_PRIM_RX) == 0 && tx_count > 0 &&
+                   (flags & NRF_STATUS::MAX_RT) == 0 && (ce_high || ce_pulse_pending);
+        }
+
+        void start_attempt(uint_fast64_t start) {
+            tx_active = true;
+            ce_pulse_pending = false;
+            retransmit_count = 0;
+            attempt_end = start + attempt_time_us(tx_fifo[0]);
+        }
+
+        void finish_attempt() {
+            fifo_entry &packet = tx_fifo[0];
+            bool expect_ack = ack_expected(packet);
+            stats.air_time_us += attempt_time_us(packet);
+
+            fifo_entry ack_payload = {};
+            bool has_ack_payload = false;
+            bool delivered = false;
+            if (medium != nullptr && !medium->lose_packet(channel())) {
+                for (size_t i = 0; i < medium->device_count && !delivered; i++) {
+                    if (medium->devices[i] != this) {
+                        delivered = medium->devices[i]->receive(*this, packet, expect_ack, ack_payload,
+                                                                has_ack_payload);
+                    }
+                }
+            }
+
+            if (expect_ack && !delivered) {
+                uint8_t retries = registers[NRF_REGISTER::SETUP_RETR][0];
+                if (retransmit_count < (retries & 0x0F)) {
+                    retransmit_count++;
+                    stats.retransmissions++;
+                    attempt_end += ((retries >> 4) + 1) * 250 + attempt_time_us(packet);
+                    return;
+                }
+                flags |= NRF_STATUS::MAX_RT;
+                if (lost_count < 15) {
+                    lost_count++;
+                }
+                stats.packets_lost++;
+                tx_active = false;
+                return;
+            }
+
+            if (has_ack_payload && rx_count < 3) {
+                rx_fifo[rx_count] = ack_payload;
+                rx_fifo[rx_count++].pipe = 0;
+                flags |= NRF_STATUS::RX_DR;
+            }
+            if (!reuse) {
+                remove_tx(0);
+            }
+            flags |= NRF_STATUS::TX_DS;
+            stats.packets_sent++;
+            tx_active = false;
+            tx_earliest = attempt_end + 130;
+        }
+
+        void remove_tx(uint8_t index) {
+            for (uint8_t i = index; i + 1 < tx_count; i++) {
+                tx_fifo[i] = tx_fifo[i + 1];
+            }
+            tx_count--;
+        }
+
+        uint8_t status() const {
+            uint8_t rx_pipe = rx_count == 0 ? 7 : rx_fifo[0].pipe;
+            return flags | (rx_pipe << 1) | (tx_count == 3 ? NRF_STATUS::TX_FULL : 0);
+        }
+
+        uint8_t fifo_status() const {
+            return (reuse ? NRF_FIFO_STATUS::TX_REUSE : 0) |
+                   (tx_count == 3 ? NRF_FIFO_STATUS::TX_FULL : 0) |
+                   (tx_count == 0 ? NRF_FIFO_STATUS::TX_EMPTY : 0) |
+                   (rx_count == 3 ? NRF_FIFO_STATUS::RX_FULL : 0) |
+                   (rx_count == 0 ? NRF_FIFO_STATUS::RX_EMPTY : 0);
+        }
+
+        uint8_t read_register_byte(uint8_t address, uint8_t index) {
+            switch (address) {
+                case NRF_REGISTER::NRF_STATUS:
+                    return status();
+                case NRF_REGISTER::OBSERVE_TX:
+                    return lost_count << 4 | retransmit_count;
+                case NRF_REGISTER::RPD:
+                    return medium != nullptr && ce_high && (config() & NRF_CONFIG::CONFIG_PRIM_RX) != 0 &&
+                           channel() < 126 && medium->channel_loss[channel()] > 0;
+                case NRF_REGISTER::FIFO_STATUS:
+                    return fifo_status();
+                default:
+                    if (address > NRF_REGISTER::FEATURE) {
+                        return 0;
+                    }
+                    return registers[address][index < 5 ? index : 4];
+            }
+        }
+
+        void write_register_byte(uint8_t address, uint8_t index, uint8_t value) {
+            if (address > NRF_REGISTER::FEATURE || index >= 5) {
+                return;
+            }
+            switch (address) {
+                case NRF_REGISTER::NRF_STATUS:
+                    flags &= ~(value & 0x70);
+                    return;
+                case NRF_REGISTER::OBSERVE_TX:
+                case NRF_REGISTER::RPD:
+                case NRF_REGISTER::FIFO_STATUS:
+                    return;
+                case NRF_REGISTER::CONFIG:
+                    if ((value & NRF_CONFIG::CONFIG_PWR_UP) != 0 && !powered()) {
+                        powered_at = clock() + 1500;
+                    }
+                    if ((value & NRF_CONFIG::CONFIG_PWR_UP) == 0) {
+                        tx_active = false;
+                    }
+                    break;
+                case NRF_REGISTER::RF_CH:
+                    lost_count = 0;
+                    break;
+                default:
+                    break;
+            }
+            registers[address][index] = value;
+        }
+
+        uint8_t shift(uint8_t out) {
+            if (!selected) {
+                return 0xFF;
+            }
+            stats.spi_bytes++;
+            if (byte_index == 0) {
+                update();
+                command = out;
+                byte_index = 1;
+                pending = {};
+                return status();
+            }
+            uint8_t index = byte_index - 1;
+            if (byte_index < 0xFF) {
+                byte_index++;
+            }
+
+            if ((command & 0xE0) == NRF_INSTRUCTION::R_REGISTER) {
+                return read_register_byte(command & 0x1F, index);
+            }
+            if ((command & 0xE0) == NRF_INSTRUCTION::W_REGISTER) {
+                write_register_byte(command & 0x1F, index, out);
+                return 0;
+            }
+            if (command == NRF_INSTRUCTION::R_RX_PL_WID) {
+                return rx_count == 0 ? 0 : rx_fifo[0].size;
+            }
+            if (command == NRF_INSTRUCTION::R_RX_PAYLOAD) {
+                return rx_count == 0 || index >= 32 ? 0 : rx_fifo[0].data[index];
+            }
+            if (command == NRF_INSTRUCTION::W_TX_PAYLOAD || command == NRF_INSTRUCTION::W_TX_PAYLOAD_NO_ACK ||
+                (command & 0xF8) == NRF_INSTRUCTION::W_ACK_PAYLOAD) {
+                if (index < 32) {
+                    pending.data[index] = out;
+                    pending.size = index + 1;
+                }
+            }
+            return 0;
+        }
+
+        void finish_command() {
+            if (byte_index == 0) {
+                return;
+            }
+            if (command == NRF_INSTRUCTION::R_RX_PAYLOAD && byte_index > 1 && rx_count > 0) {
+                for (uint8_t i = 0; i + 1 < rx_count; i++) {
+                    rx_fifo[i] = rx_fifo[i + 1];
+                }
+                rx_count--;
+            } else if ((command == NRF_INSTRUCTION::W_TX_PAYLOAD || command == NRF_INSTRUCTION::W_TX_PAYLOAD_NO_ACK) &&
+                       pending.size > 0 && tx_count < 3) {
+                pending.noack = command == NRF_INSTRUCTION::W_TX_PAYLOAD_NO_ACK;
+                tx_fifo[tx_count++] = pending;
+                reuse = false;
+            } else if ((command & 0xF8) == NRF_INSTRUCTION::W_ACK_PAYLOAD && (command & 0x07) < 6 &&
+                       (registers[NRF_REGISTER::FEATURE][0] & NRF_FEATURE::EN_ACK_PAY) != 0 && tx_count < 3) {
+                pending.pipe = command & 0x07;
+                tx_fifo[tx_count++] = pending;
+            } else if (command == NRF_INSTRUCTION::FLUSH_TX) {
+                tx_count = 0;
+                reuse = false;
+                tx_active = false;
+            } else if (command == NRF_INSTRUCTION::FLUSH_RX) {
+                rx_count = 0;
+            } else if (command == NRF_INSTRUCTION::REUSE_TX_PL) {
+                reuse = true;
+            }
+        }
+
+        void csn_write(bool level) {
+            if (!level && !selected) {
+                selected = true;
+                byte_index = 0;
+                stats.spi_transactions++;
+            } else if (level && selected) {
+                finish_command();
+                selected = false;
+                update();
+            }
+        }
+
+        void ce_write(bool level) {
+            update();
+            if (level && !ce_high) {
+                uint_fast64_t now = clock();
+                if ((config() & NRF_CONFIG::CONFIG_PRIM_RX) != 0) {
+                    rx_ready_at = now + 130;
+                } else {
+                    ce_pulse_pending = true;
+                    if (tx_earliest < now + 130) {
+                        tx_earliest = now + 130;
+                    }
+                }
+            }
+            ce_high = level;
+            update();
+        }
+    };
+
+    inline void simulated_medium::attach(simulated_nrf24l01plus &device) {
+        if (device_count < MAX_DEVICES) {
+            devices[device_count++] = &device;
+            device.medium = this;
+        }
+    }
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_SIMULATED_DEVICE_HPP
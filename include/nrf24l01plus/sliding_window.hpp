@@ -0,0 +1,330 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_SLIDING_WINDOW_HPP
+#define PROJECT_NRF24L01_SLIDING_WINDOW_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Frame layout of the sliding window transport
+     *
+     * Data and poll frames start with 2 header bytes:
+     *  - byte 0: frame type
+     *  - byte 1: sequence number (data frames)
+     *
+     * Acknowledgements are returned in the ACK payload of poll frames:
+     *  - byte 0: SACK
+     *  - byte 1: cumulative acknowledgement, the next sequence number the receiver expects
+     *  - byte 2-5: selective acknowledgement, bit i (LSByte first) is set if sequence number cumulative + 1 + i was received
+     */
+    struct NRF_WINDOW {
+        //! Size of the data frame header
+        static constexpr const uint8_t HEADER_SIZE = 2;
+        //! Data bytes per frame
+        static constexpr const uint8_t DATA_SIZE = 32 - HEADER_SIZE;
+        //! Size of an acknowledgement
+        static constexpr const uint8_t SACK_SIZE = 6;
+        //! Frame type: data, sent without acknowledgement
+        static constexpr const uint8_t DATA = 0x00;
+        //! Frame type: poll, sent with acknowledgement, to collect the acknowledgement payload
+        static constexpr const uint8_t POLL = 0x01;
+        //! Frame type: selective acknowledgement
+        static constexpr const uint8_t SACK = 0x02;
+    };
+
+    /**
+     * \brief Sending side of a sliding window transport
+     *
+     * Hardware auto acknowledgement waits for every payload to be acknowledged before the next one is sent.
+     * This sender streams a window of data frames with NO_ACK, back to back, and then sends one poll frame with
+     * auto acknowledgement. The receiver returns its acknowledgement state in the ACK payload of the poll,
+     * after which only the missing frames are sent again.
+     *
+     * Both ends need ACK payloads (nrf24l01plus::ack_payload_enabled(const bool&)) and the EN_DYN_ACK feature.
+     * The module should have its TX address and RX pipe 0 address set to the receiver.
+     * @tparam W Window size, a power of two up to 32
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<size_t W = 16, typename Radio = nrf24l01plus>
+    class window_sender {
+        static_assert(W > 0 && W <= 32 && (W & (W - 1)) == 0, "Window size needs to be a power of two up to 32");
+
+        struct segment {
+            uint8_t data[NRF_WINDOW::DATA_SIZE];
+            uint8_t size;
+            bool needs_send;
+            bool acked;
+        };
+
+        Radio &nrf;
+        segment segments[W] = {};
+        uint8_t base = 0;
+        uint8_t next = 0;
+        uint_fast64_t poll_at = 0;
+
+    public:
+        //! Time between sending frames and polling for their acknowledgement
+        uint_fast64_t poll_delay_us = 500;
+        //! Amount of data frames that were sent again
+        uint32_t retransmitted = 0;
+        //! Amount of polls that did not return an acknowledgement
+        uint32_t failed_polls = 0;
+
+        /**
+         * \brief Create a sender
+         * @param nrf Module to send on
+         */
+        explicit window_sender(Radio &nrf) : nrf(nrf) {}
+
+        /**
+         * \brief Add data to the window, it is sent on the next call to service()
+         * @param data The data
+         * @param size Size of the data, at most NRF_WINDOW::DATA_SIZE bytes
+         * @return False if the window is full or the data is too large
+         */
+        bool send(const uint8_t *data, uint8_t size) {
+            if (in_flight() >= W || size > NRF_WINDOW::DATA_SIZE) {
+                return false;
+            }
+            segment &s = segments[next % W];
+            for (uint8_t i = 0; i < size; i++) {
+                s.data[i] = data[i];
+            }
+            s.size = size;
+            s.needs_send = true;
+            s.acked = false;
+            next++;
+            return true;
+        }
+
+        /**
+         * \brief Amount of frames that were not acknowledged yet
+         */
+        uint8_t in_flight() const {
+            return uint8_t(next - base);
+        }
+
+        /**
+         * \brief Check if all data was acknowledged
+         */
+        bool idle() const {
+            return base == next;
+        }
+
+        /**
+         * \brief Send the frames that need to be sent, or poll for an acknowledgement, should be called regularly
+         *
+         * When frames need to be sent, they are streamed and the poll is scheduled poll_delay_us later,
+         * to give the receiver time to update its acknowledgement. Otherwise, the poll is sent when it is due.
+         * Blocks until the frames or the poll have been sent.
+         * @return False if a poll did not return an acknowledgement
+         */
+        bool service() {
+            if (idle()) {
+                return true;
+            }
+            uint8_t frame[32];
+            nrf.mode(nrf.MODE_PTX);
+
+            bool streaming = false;
+            for (uint8_t seq = base; seq != next; seq++) {
+                segment &s = segments[seq % W];
+                if (!s.needs_send || s.acked) {
+                    continue;
+                }
+                if (!streaming) {
+                    nrf.tx_stream_begin();
+                    streaming = true;
+                }
+                frame[0] = NRF_WINDOW::DATA;
+                frame[1] = seq;
+                for (uint8_t i = 0; i < s.size; i++) {
+                    frame[NRF_WINDOW::HEADER_SIZE + i] = s.data[i];
+                }
+                nrf.tx_stream_write(frame, NRF_WINDOW::HEADER_SIZE + s.size, true);
+                s.needs_send = false;
+            }
+            if (streaming) {
+                nrf.tx_stream_end();
+                poll_at = hwlib::now_us() + poll_delay_us;
+                return true;
+            }
+            if (hwlib::now_us() < poll_at) {
+                return true;
+            }
+
+            bool acknowledged = poll();
+            if (!acknowledged) {
+                failed_polls++;
+                poll_at = hwlib::now_us() + poll_delay_us;
+            }
+            return acknowledged;
+        }
+
+    private:
+        bool poll() {
+            uint8_t frame[32] = {NRF_WINDOW::POLL, next};
+            nrf.tx_stream_begin();
+            nrf.tx_stream_write(frame, NRF_WINDOW::HEADER_SIZE);
+            if (!nrf.tx_stream_end()) {
+                return false;
+            }
+
+            bool acknowledged = false;
+            uint8_t width;
+            while ((width = nrf.tx_read_ack_payload(frame)) != 0) {
+                if (width == NRF_WINDOW::SACK_SIZE && frame[0] == NRF_WINDOW::SACK) {
+                    acknowledged = process_sack(frame[1], frame[2] | frame[3] << 8 | frame[4] << 16 |
+                                                                 uint32_t(frame[5]) << 24);
+                }
+            }
+            return acknowledged;
+        }
+
+        bool process_sack(uint8_t cumulative, uint32_t selective) {
+            if (uint8_t(cumulative - base) > in_flight()) {
+                return false;
+            }
+            base = cumulative;
+            for (uint8_t seq = base; seq != next; seq++) {
+                segment &s = segments[seq % W];
+                uint8_t offset = seq - base;
+                if (offset > 0 && (selective & (1ul << (offset - 1))) != 0) {
+                    s.acked = true;
+                } else if (!s.acked && !s.needs_send) {
+                    s.needs_send = true;
+                    retransmitted++;
+                }
+            }
+            return true;
+        }
+    };
+
+    /**
+     * \brief Interface for receiving data from a sliding window transport, in order
+     */
+    class window_data_receiver {
+    public:
+        /**
+         * \brief Called for every data frame, in the order they were sent
+         * @param data The data
+         * @param size Size of the data
+         */
+        virtual void window_received(const uint8_t *data, uint8_t size) = 0;
+    };
+
+    /**
+     * \brief Receiving side of a sliding window transport, see window_sender
+     *
+     * Frames that arrive out of order are kept until the missing frames arrive. After every change,
+     * the acknowledgement state is loaded as ACK payload, so it is returned with the next poll.
+     * The receiver uses the TX FIFO for this, so it can't be used for other ACK payloads at the same time.
+     * The RX FIFO only holds 3 frames, so service() needs to be called often (or from the IRQ) to keep up with a
+     * streaming sender; frames that didn't fit are sent again.
+     * @tparam W Window size, the same as the sender's
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<size_t W = 16, typename Radio = nrf24l01plus>
+    class window_receiver {
+        static_assert(W > 0 && W <= 32 && (W & (W - 1)) == 0, "Window size needs to be a power of two up to 32");
+
+        Radio &nrf;
+        uint8_t pipe;
+        window_data_receiver *receiver;
+        uint8_t data[W][NRF_WINDOW::DATA_SIZE] = {};
+        uint8_t sizes[W] = {0};
+        bool present[W] = {false};
+        uint8_t expected = 0;
+
+    public:
+        //! Amount of data frames that were received more than once
+        uint32_t duplicates = 0;
+
+        /**
+         * \brief Create a receiver, and load the first acknowledgement
+         * @param nrf Module to receive on, in PRX mode
+         * @param pipe Pipe the sender sends to
+         * @param data_receiver Receiver to hand the data to
+         */
+        window_receiver(Radio &nrf, uint8_t pipe, window_data_receiver *data_receiver) :
+                nrf(nrf), pipe(pipe), receiver(data_receiver) {
+            load_sack();
+        }
+
+        /**
+         * \brief Read received frames, hand over the data that is in order, and update the acknowledgement
+         *
+         * Should be called regularly
+         */
+        void service() {
+            bool changed = false;
+            nrf.rx_drain([&](uint8_t frame_pipe, const uint8_t *frame, uint8_t width) {
+                if (frame_pipe != pipe || width < NRF_WINDOW::HEADER_SIZE) {
+                    return;
+                }
+                // A poll took the acknowledgement out of the TX FIFO
+                changed = true;
+                if (frame[0] != NRF_WINDOW::DATA) {
+                    return;
+                }
+                uint8_t seq = frame[1];
+                uint8_t offset = seq - expected;
+                if (offset >= W || present[seq % W]) {
+                    duplicates++;
+                    return;
+                }
+                sizes[seq % W] = width - NRF_WINDOW::HEADER_SIZE;
+                for (uint8_t i = 0; i < sizes[seq % W]; i++) {
+                    data[seq % W][i] = frame[NRF_WINDOW::HEADER_SIZE + i];
+                }
+                present[seq % W] = true;
+            });
+
+            while (present[expected % W]) {
+                present[expected % W] = false;
+                if (receiver != nullptr) {
+                    receiver->window_received(data[expected % W], sizes[expected % W]);
+                }
+                expected++;
+            }
+            if (changed) {
+                load_sack();
+            }
+        }
+
+    private:
+        void load_sack() {
+            uint32_t selective = 0;
+            for (uint8_t i = 1; i < W; i++) {
+                if (present[uint8_t(expected + i) % W]) {
+                    selective |= 1ul << (i - 1);
+                }
+            }
+            uint8_t sack[NRF_WINDOW::SACK_SIZE] = {
+                    NRF_WINDOW::SACK, expected,
+                    uint8_t(selective), uint8_t(selective >> 8), uint8_t(selective >> 16), uint8_t(selective >> 24)
+            };
+            nrf.tx_flush();
+            nrf.rx_write_ack_payload(pipe, sack, NRF_WINDOW::SACK_SIZE);
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_SLIDING_WINDOW_HPP
@@ -0,0 +1,140 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_SNAPSHOT_HPP
+#define PROJECT_NRF24L01_SNAPSHOT_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Copy of all configuration registers of an NRF24L01+
+     *
+     * Registers the module changes by itself (STATUS, OBSERVE_TX, RPD and FIFO_STATUS) are not part of a snapshot.
+     * The register contents are stored back to back, in the byte order they are sent over SPI.
+     */
+    struct register_snapshot {
+        //! Amount of registers in a snapshot
+        static constexpr const uint8_t REGISTER_COUNT = 22;
+        //! Registers in a snapshot, in the order they are stored and restored
+        static constexpr const uint8_t REGISTERS[REGISTER_COUNT] = {
+                NRF_REGISTER::EN_AA, NRF_REGISTER::EN_RXADDR, NRF_REGISTER::SETUP_AW, NRF_REGISTER::SETUP_RETR,
+                NRF_REGISTER::RF_CH, NRF_REGISTER::RF_SETUP, NRF_REGISTER::RX_ADDR_P0, NRF_REGISTER::RX_ADDR_P1,
+                NRF_REGISTER::RX_ADDR_P2, NRF_REGISTER::RX_ADDR_P3, NRF_REGISTER::RX_ADDR_P4, NRF_REGISTER::RX_ADDR_P5,
+                NRF_REGISTER::TX_ADDR, NRF_REGISTER::RX_PW_P0, NRF_REGISTER::RX_PW_P1, NRF_REGISTER::RX_PW_P2,
+                NRF_REGISTER::RX_PW_P3, NRF_REGISTER::RX_PW_P4, NRF_REGISTER::RX_PW_P5, NRF_REGISTER::FEATURE,
+                NRF_REGISTER::DYNPD, NRF_REGISTER::CONFIG
+        };
+        //! Largest total size of all registers, 19 single byte registers and 3 address registers of up to 5 bytes
+        static constexpr const uint8_t SIZE = 19 + 3 * 5;
+
+        //! Register contents
+        uint8_t bytes[SIZE] = {0};
+
+        /**
+         * \brief Check if two snapshots hold the same register contents
+         * @param rhs Snapshot to compare to
+         * @return True if all bytes are equal
+         */
+        bool operator==(const register_snapshot &rhs) const {
+            for (uint8_t i = 0; i < SIZE; i++) {
+                if (bytes[i] != rhs.bytes[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * \brief Check if two snapshots differ
+         * @param rhs Snapshot to compare to
+         * @return True if any byte differs
+         */
+        bool operator!=(const register_snapshot &rhs) const {
+            return !(*this == rhs);
+        }
+    };
+
+    /**
+     * \brief Read all configuration registers into a snapshot
+     *
+     * With the register cache enabled (and filled), this doesn't need any SPI transactions.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     * @param nrf Module to read from
+     * @return The snapshot
+     */
+    template<typename Radio>
+    register_snapshot take_snapshot(Radio &nrf) {
+        register_snapshot snapshot;
+        uint8_t offset = 0;
+        for (uint8_t address : register_snapshot::REGISTERS) {
+            nrf.read_register(address, snapshot.bytes + offset);
+            offset += nrf.register_bytes(address);
+        }
+        return snapshot;
+    }
+
+    /**
+     * \brief Restore a snapshot, writing only the registers that differ from the current state
+     *
+     * The module is put in MODE_NONE first, select a mode again after restoring.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     * @param nrf Module to write to
+     * @param target Snapshot to restore
+     * @param current Snapshot of the current register contents
+     * @return Amount of registers written
+     */
+    template<typename Radio>
+    uint8_t restore_snapshot(Radio &nrf, const register_snapshot &target, const register_snapshot &current) {
+        nrf.mode(nrf.MODE_NONE);
+        uint8_t writes = 0;
+        uint8_t offset = 0;
+        bool width_changed = false;
+        for (uint8_t address : register_snapshot::REGISTERS) {
+            // Writing SETUP_AW changes the size of the address registers that follow it
+            uint8_t size = nrf.register_bytes(address);
+            for (uint8_t i = 0; i < size; i++) {
+                if (width_changed || target.bytes[offset + i] != current.bytes[offset + i]) {
+                    nrf.write_register(address, target.bytes + offset);
+                    width_changed |= address == NRF_REGISTER::SETUP_AW;
+                    writes++;
+                    break;
+                }
+            }
+            offset += size;
+        }
+        return writes;
+    }
+
+    /**
+     * \brief Restore a snapshot, writing only the registers that differ from the current state
+     *
+     * The current state is read from the module first. With the register cache enabled this is free,
+     * otherwise prefer restore_snapshot(Radio&, const register_snapshot&, const register_snapshot&) with a known state.
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     * @param nrf Module to write to
+     * @param target Snapshot to restore
+     * @return Amount of registers written
+     */
+    template<typename Radio>
+    uint8_t restore_snapshot(Radio &nrf, const register_snapshot &target) {
+        return restore_snapshot(nrf, target, take_snapshot(nrf));
+    }
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_SNAPSHOT_HPP
@@ -0,0 +1,115 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_SPSC_RING_HPP
+#define PROJECT_NRF24L01_SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Fixed size, lock-free ring buffer for a single producer and a single consumer
+     *
+     * Safe to use between an interrupt routine and the main loop, as long as each side only calls either
+     * push() or pop(). No locks or heap allocation are used.
+     * @tparam T Type of the items
+     * @tparam N Capacity, needs to be a power of two
+     */
+    template<typename T, size_t N>
+    class spsc_ring {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "spsc_ring capacity needs to be a power of two");
+
+        T items[N] = {};
+        std::atomic<size_t> head{0};
+        std::atomic<size_t> tail{0};
+
+    public:
+        /**
+         * \brief Add an item (producer side)
+         * @param item Item to add
+         * @return False if the ring was full
+         */
+        bool push(const T &item) {
+            size_t current_tail = tail.load(std::memory_order_relaxed);
+            if (current_tail - head.load(std::memory_order_acquire) == N) {
+                return false;
+            }
+            items[current_tail & (N - 1)] = item;
+            tail.store(current_tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * \brief Remove the oldest item (consumer side)
+         * @param item Location to move the item into
+         * @return False if the ring was empty
+         */
+        bool pop(T &item) {
+            size_t current_head = head.load(std::memory_order_relaxed);
+            if (current_head == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = items[current_head & (N - 1)];
+            head.store(current_head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * \brief Look at the oldest item without removing it (consumer side)
+         * @return Pointer to the item, or nullptr if the ring is empty
+         */
+        T *peek() {
+            size_t current_head = head.load(std::memory_order_relaxed);
+            if (current_head == tail.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            return &items[current_head & (N - 1)];
+        }
+
+        /**
+         * \brief Amount of items in the ring
+         */
+        size_t size() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        /**
+         * \brief Check if the ring is empty
+         */
+        bool empty() const {
+            return size() == 0;
+        }
+
+        /**
+         * \brief Check if the ring is full
+         */
+        bool full() const {
+            return size() == N;
+        }
+
+        /**
+         * \brief Capacity of the ring
+         */
+        static constexpr size_t capacity() {
+            return N;
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_SPSC_RING_HPP
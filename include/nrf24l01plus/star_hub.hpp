@@ -0,0 +1,405 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_STAR_HUB_HPP
+#define PROJECT_NRF24L01_STAR_HUB_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+#include <nrf24l01plus/packet_pool.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Deficit round robin selection between a fixed amount of queues
+     *
+     * Every time a queue gets its turn, its deficit grows by quantum bytes, and it may send items as long as
+     * they fit in its deficit. Queues with small items get as many bytes through as queues with large items,
+     * and a queue with a lot of items can't starve the others. Queues without items lose their deficit.
+     * @tparam queues Amount of queues
+     */
+    template<size_t queues>
+    class deficit_round_robin {
+        uint16_t deficit[queues] = {0};
+        size_t current = 0;
+        bool turn_started = false;
+
+    public:
+        //! Bytes added to the deficit of a queue every turn, at least the largest item size
+        uint16_t quantum = 32;
+
+        /**
+         * \brief Select the queue to take the next item from
+         * @tparam F Callable with (size_t queue), returning the size of the first item of that queue, 0 if it has none
+         * @param head_size Function to get the size of the first item of a queue
+         * @return Index of the selected queue, or -1 if no queue has items
+         */
+        template<typename F>
+        int select(F &&head_size) {
+            for (size_t visited = 0; visited <= queues;) {
+                uint16_t size = head_size(current);
+                if (size == 0) {
+                    deficit[current] = 0;
+                    next_turn();
+                    visited++;
+                    continue;
+                }
+                if (!turn_started) {
+                    deficit[current] += quantum;
+                    turn_started = true;
+                }
+                if (size <= deficit[current]) {
+                    deficit[current] -= size;
+                    return int(current);
+                }
+                next_turn();
+                visited++;
+            }
+            return -1;
+        }
+
+    private:
+        void next_turn() {
+            current = (current + 1) % queues;
+            turn_started = false;
+        }
+    };
+
+    /**
+     * \brief Hub of a star network, talking to up to six peers at once
+     *
+     * Every peer gets its own RX pipe, with an address that consists of the base address and one address byte
+     * per peer. The hub stays in PRX mode, and replies to the peers using ACK payloads.
+     * Each peer has its own inbound and outbound queue, so a peer that sends a lot, or that doesn't pick up its replies,
+     * only fills its own queues.
+     *
+     * The TX FIFO only fits 3 ACK payloads, and an ACK payload is only sent when its peer sends something.
+     * To prevent silent peers from blocking the FIFO, every peer has at most one ACK payload loaded, and payloads that
+     * weren't picked up within ack_timeout_us are taken out again, until the peer is heard from.
+     * Free FIFO slots are handed out with deficit round robin, and receive() uses deficit round robin across the
+     * inbound queues, so one chatty peer can't starve the others.
+     *
+     * A reply counts as delivered when a payload of its peer arrives that was received after the reply was loaded.
+     * When payloads were already waiting in the RX FIFO at load time, the next payload of the peer may predate the
+     * reply; the reply is then only counted as delivered when TX_DS and the TX FIFO confirm that it left the module,
+     * or with the peer's payload after that.
+     *
+     * The module needs to be powered up; the hub enables DPL and ACK payloads itself.
+     * @tparam N Queue size per direction per peer, needs to be a power of two
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<size_t N = 4, typename Radio = nrf24l01plus>
+    class star_hub {
+    public:
+        //! Amount of RX pipes
+        static constexpr const uint8_t PIPES = 6;
+
+        //! Time an ACK payload may wait for its peer, before it is taken out of the TX FIFO
+        uint_fast64_t ack_timeout_us = 50000;
+        //! Amount of received payloads that were dropped because the queue of their peer was full
+        uint32_t dropped = 0;
+
+    private:
+        struct peer {
+            bool attached = false;
+            uint8_t address_byte = 0;
+            bool loaded = false;
+            bool raced = false;
+            bool stalled = false;
+            uint_fast64_t loaded_at = 0;
+            spsc_ring<packet, N> inbound;
+            spsc_ring<packet, N> outbound;
+        };
+
+        Radio &nrf;
+        address base;
+        peer peers[PIPES];
+        uint8_t loaded_count = 0;
+        deficit_round_robin<PIPES> tx_scheduler;
+        deficit_round_robin<PIPES> rx_scheduler;
+
+    public:
+        /**
+         * \brief Create a hub, with all pipes closed
+         * @param nrf The module to use
+         * @param base Base address, the first 4 bytes are shared by all peers
+         */
+        star_hub(Radio &nrf, const address &base) : nrf(nrf), base(base) {
+            address pipe_1(base, 0);
+            nrf.rx_set_address(1, pipe_1);
+            nrf.rx_enabled(false);
+            nrf.ack_payload_enabled(true);
+            nrf.tx_flush();
+            nrf.rx_flush();
+            nrf.mode(nrf.MODE_PRX);
+        }
+
+        star_hub(const star_hub &) = delete;
+
+        star_hub &operator=(const star_hub &) = delete;
+
+        /**
+         * \brief Open a pipe for a peer
+         *
+         * Pipes 1 to 5 are used first, pipe 0 is used last
+         * @param address_byte Last address byte of the peer, needs to be unique
+         * @return The pipe of the peer, or -1 if all pipes are in use or the address byte is already used
+         */
+        int attach(uint8_t address_byte) {
+            int free_pipe = -1;
+            for (uint8_t i = 0; i < PIPES; i++) {
+                uint8_t pipe = (i + 1) % PIPES;
+                if (peers[pipe].attached && peers[pipe].address_byte == address_byte) {
+                    return -1;
+                }
+                if (!peers[pipe].attached && free_pipe < 0) {
+                    free_pipe = pipe;
+                }
+            }
+            if (free_pipe < 0) {
+                return -1;
+            }
+
+            peer &p = peers[free_pipe];
+            reset(p);
+            p.attached = true;
+            p.address_byte = address_byte;
+            address peer_address(base, address_byte);
+            nrf.rx_set_address(free_pipe, peer_address);
+            nrf.rx_auto_acknowledgement(free_pipe, true);
+            nrf.rx_enabled(free_pipe, true);
+            return free_pipe;
+        }
+
+        /**
+         * \brief Close the pipe of a peer, and drop its queues
+         * @param pipe The pipe of the peer
+         */
+        void detach(uint8_t pipe) {
+            if (pipe >= PIPES || !peers[pipe].attached) {
+                return;
+            }
+            nrf.rx_enabled(pipe, false);
+            if (peers[pipe].loaded) {
+                unload_all();
+            }
+            reset(peers[pipe]);
+        }
+
+        /**
+         * \brief Check if a pipe is in use by a peer
+         */
+        bool attached(uint8_t pipe) const {
+            return pipe < PIPES && peers[pipe].attached;
+        }
+
+        /**
+         * \brief Queue a reply for a peer, it is sent as ACK payload on one of its next transmissions
+         * @param pipe The pipe of the peer
+         * @param data The data
+         * @param size Size of the data, at most 32 bytes
+         * @return False if the peer's outbound queue is full, or the pipe is not attached
+         */
+        bool send(uint8_t pipe, const uint8_t *data, uint8_t size) {
+            if (!attached(pipe) || size > 32 || size == 0) {
+                return false;
+            }
+            packet p = {};
+            for (uint8_t i = 0; i < size; i++) {
+                p.data[i] = data[i];
+            }
+            p.pipe = pipe;
+            p.length = size;
+            p.timestamp = static_cast<uint32_t>(hwlib::now_us());
+            return peers[pipe].outbound.push(p);
+        }
+
+        /**
+         * \brief Take the next received packet, from the peers in deficit round robin order
+         * @param out Packet to copy into
+         * @return False if no packet is waiting
+         */
+        bool receive(packet &out) {
+            int pipe = rx_scheduler.select([this](size_t i) -> uint16_t {
+                packet *head = peers[i].inbound.peek();
+                return head == nullptr ? 0 : head->length;
+            });
+            return pipe >= 0 && peers[pipe].inbound.pop(out);
+        }
+
+        /**
+         * \brief Take the next received packet of one peer
+         * @param pipe The pipe of the peer
+         * @param out Packet to copy into
+         * @return False if no packet is waiting
+         */
+        bool receive(uint8_t pipe, packet &out) {
+            return pipe < PIPES && peers[pipe].inbound.pop(out);
+        }
+
+        /**
+         * \brief Amount of replies waiting for a peer, including a loaded ACK payload
+         */
+        size_t pending(uint8_t pipe) const {
+            return pipe < PIPES ? peers[pipe].outbound.size() : 0;
+        }
+
+        /**
+         * \brief Move received payloads into the inbound queues, and ACK payloads into the TX FIFO
+         *
+         * Should be called regularly, or after the IRQ pin went low. Clears the interrupt flags.
+         */
+        void service() {
+            uint_fast64_t now = hwlib::now_us();
+            uint8_t flags = nrf.clear_interrupts();
+            uint8_t unconfirmed = 0;
+            nrf.rx_drain([&](uint8_t pipe, const uint8_t *data, uint8_t width) {
+                peer &p = peers[pipe];
+                if (!p.attached) {
+                    dropped++;
+                    return;
+                }
+                if (p.loaded && p.raced) {
+                    // This payload may have been received before the reply was loaded, any later one was not
+                    p.raced = false;
+                    unconfirmed |= 1u << pipe;
+                } else if (p.loaded) {
+                    // The reply was loaded before this payload arrived, so its ACK carried the reply
+                    delivered(p);
+                    unconfirmed &= ~(1u << pipe);
+                }
+                p.stalled = false;
+
+                packet received = {};
+                for (uint8_t i = 0; i < width; i++) {
+                    received.data[i] = data[i];
+                }
+                received.pipe = pipe;
+                received.length = width;
+                received.timestamp = static_cast<uint32_t>(now);
+                if (!p.inbound.push(received)) {
+                    dropped++;
+                }
+            });
+            if (unconfirmed != 0) {
+                confirm(unconfirmed, flags);
+            }
+
+            expire(now);
+            schedule(now);
+        }
+
+    private:
+        void reset(peer &p) {
+            packet discarded;
+            while (p.inbound.pop(discarded)) {
+            }
+            while (p.outbound.pop(discarded)) {
+            }
+            p.attached = false;
+            p.loaded = false;
+            p.raced = false;
+            p.stalled = false;
+        }
+
+        void delivered(peer &p) {
+            packet sent;
+            p.outbound.pop(sent);
+            p.loaded = false;
+            p.raced = false;
+            loaded_count--;
+        }
+
+        void confirm(uint8_t unconfirmed, uint8_t flags) {
+            if ((flags & NRF_STATUS::TX_DS) == 0) {
+                // No ACK payload left the module, the replies go out with the next payloads of their peers
+                return;
+            }
+            if ((nrf.fifo_status() & NRF_FIFO_STATUS::TX_EMPTY) == 0) {
+                // Some reply went out, but not all of them: it's unknown which, wait for the next payloads of the peers
+                return;
+            }
+            for (uint8_t pipe = 0; pipe < PIPES; pipe++) {
+                if ((unconfirmed & (1u << pipe)) != 0 && peers[pipe].loaded) {
+                    delivered(peers[pipe]);
+                }
+            }
+        }
+
+        void unload_all() {
+            nrf.tx_flush();
+            for (auto &p : peers) {
+                p.loaded = false;
+                p.raced = false;
+            }
+            loaded_count = 0;
+        }
+
+        void expire(uint_fast64_t now) {
+            bool expired = false;
+            for (auto &p : peers) {
+                if (p.loaded && now - p.loaded_at > ack_timeout_us) {
+                    p.stalled = true;
+                    expired = true;
+                }
+            }
+            if (expired) {
+                // ACK payloads can't be removed one by one, the others are loaded again by schedule()
+                unload_all();
+            }
+        }
+
+        void schedule(uint_fast64_t now) {
+            uint8_t loaded_now = 0;
+            while (loaded_count < 3) {
+                int pipe = tx_scheduler.select([this](size_t i) -> uint16_t {
+                    peer &p = peers[i];
+                    if (!p.attached || p.loaded || p.stalled) {
+                        return 0;
+                    }
+                    const packet *head = p.outbound.peek();
+                    return head == nullptr ? 0 : head->length;
+                });
+                if (pipe < 0) {
+                    break;
+                }
+                peer &p = peers[pipe];
+                const packet *head = p.outbound.peek();
+                if (!nrf.rx_write_ack_payload(pipe, head->data, head->length)) {
+                    break;
+                }
+                p.loaded = true;
+                p.loaded_at = now;
+                loaded_count++;
+                loaded_now |= 1u << pipe;
+            }
+            if (loaded_now == 0) {
+                return;
+            }
+            // Payloads that are waiting in the RX FIFO now may have been acknowledged without the new replies
+            nrf.no_operation();
+            if ((nrf.last_status & NRF_STATUS::RX_P_NO) != NRF_STATUS::RX_P_NO) {
+                for (uint8_t i = 0; i < PIPES; i++) {
+                    if ((loaded_now & (1u << i)) != 0) {
+                        peers[i].raced = true;
+                    }
+                }
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_STAR_HUB_HPP
@@ -0,0 +1,404 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_TREE_NETWORK_HPP
+#define PROJECT_NRF24L01_TREE_NETWORK_HPP
+
+#include <nrf24l01plus/nrf24l01plus.hpp>
+#include <nrf24l01plus/packet_pool.hpp>
+
+namespace nrf24l01 {
+    /**
+     * \addtogroup nrf24l01Plus
+     * @{
+     */
+
+    /**
+     * \brief Hierarchical node addresses for a tree network
+     *
+     * A node address is a series of octal digits, read from the least significant digit. The root is 0,
+     * its children are 1 to 5, the children of node 3 are 013 to 053, and so on, up to MAX_DEPTH levels.
+     * Every digit is the pipe a child uses to reach its parent.
+     */
+    struct tree_address {
+        //! Largest amount of digits in an address
+        static constexpr const uint8_t MAX_DEPTH = 5;
+        //! Address of the root node
+        static constexpr const uint16_t ROOT = 0;
+
+        /**
+         * \brief Amount of digits in an address, 0 for the root
+         */
+        static constexpr uint8_t depth(uint16_t node) {
+            uint8_t result = 0;
+            while (node != 0) {
+                node >>= 3;
+                result++;
+            }
+            return result;
+        }
+
+        /**
+         * \brief Check if every digit of an address is between 1 and 5
+         */
+        static constexpr bool valid(uint16_t node) {
+            for (uint8_t i = 0; i < MAX_DEPTH && node != 0; i++, node >>= 3) {
+                if ((node & 7) == 0 || (node & 7) > 5) {
+                    return false;
+                }
+            }
+            return node == 0;
+        }
+
+        /**
+         * \brief Parent of a node, the node itself for the root
+         */
+        static constexpr uint16_t parent(uint16_t node) {
+            uint8_t levels = depth(node);
+            return levels == 0 ? node : node & ((1u << (3 * (levels - 1))) - 1);
+        }
+
+        /**
+         * \brief Pipe a node uses to reach its parent (its last digit)
+         */
+        static constexpr uint8_t parent_pipe(uint16_t node) {
+            uint8_t levels = depth(node);
+            return levels == 0 ? 0 : (node >> (3 * (levels - 1))) & 7;
+        }
+
+        /**
+         * \brief Check if a node is in the subtree of another node, including the node itself
+         */
+        static constexpr bool in_subtree(uint16_t node, uint16_t subtree) {
+            uint8_t levels = depth(subtree);
+            return depth(node) >= levels && (node & ((1u << (3 * levels)) - 1)) == subtree;
+        }
+
+        /**
+         * \brief The child of a node that leads to a node in its subtree
+         */
+        static constexpr uint16_t child_toward(uint16_t node, uint16_t destination) {
+            uint8_t levels = depth(node);
+            return destination & ((1u << (3 * (levels + 1))) - 1);
+        }
+
+        /**
+         * \brief Pipe address a node listens on
+         *
+         * Pipe 0 is used for frames from the parent (and route table neighbours), pipes 1 to 5 for frames from children.
+         * Pipes 1 to 5 only differ in their last byte, as the module requires.
+         * @param network Network identifier, shared by all nodes
+         * @param node Node address
+         * @param pipe Pipe number
+         */
+        static address pipe_address(uint16_t network, uint16_t node, uint8_t pipe) {
+            static constexpr const uint8_t PIPE_BYTES[6] = {0xC3, 0x3C, 0x33, 0xCE, 0x3E, 0xE3};
+            return {uint8_t(network >> 8), uint8_t(network), uint8_t(node >> 8), uint8_t(node), PIPE_BYTES[pipe % 6]};
+        }
+    };
+
+    /**
+     * \brief Fixed size table of routes that override the tree, for example shortcuts between neighbouring nodes
+     * @tparam N Amount of routes
+     */
+    template<size_t N>
+    class tree_route_table {
+        struct route {
+            uint16_t subtree;
+            uint16_t next_hop;
+            bool used;
+        };
+
+        route routes[N] = {};
+
+    public:
+        /**
+         * \brief Add or replace a route
+         * @param subtree Frames for nodes in this subtree are sent through next_hop
+         * @param next_hop Neighbour to send the frames to, it receives them on its pipe 0
+         * @return False if the table is full
+         */
+        bool add(uint16_t subtree, uint16_t next_hop) {
+            route *free_route = nullptr;
+            for (auto &r : routes) {
+                if (r.used && r.subtree == subtree) {
+                    r.next_hop = next_hop;
+                    return true;
+                }
+                if (!r.used && free_route == nullptr) {
+                    free_route = &r;
+                }
+            }
+            if (free_route == nullptr) {
+                return false;
+            }
+            *free_route = {subtree, next_hop, true};
+            return true;
+        }
+
+        /**
+         * \brief Remove the route for a subtree
+         */
+        void remove(uint16_t subtree) {
+            for (auto &r : routes) {
+                if (r.used && r.subtree == subtree) {
+                    r.used = false;
+                }
+            }
+        }
+
+        /**
+         * \brief Find the most specific route for a destination
+         * @param destination The destination
+         * @param next_hop Set to the neighbour to send to, if a route was found
+         * @return True if a route was found
+         */
+        bool lookup(uint16_t destination, uint16_t &next_hop) const {
+            int best_depth = -1;
+            for (const auto &r : routes) {
+                if (r.used && tree_address::in_subtree(destination, r.subtree) &&
+                    tree_address::depth(r.subtree) > best_depth) {
+                    best_depth = tree_address::depth(r.subtree);
+                    next_hop = r.next_hop;
+                }
+            }
+            return best_depth >= 0;
+        }
+    };
+
+    /**
+     * \brief Interface for receiving frames addressed to a tree network node
+     */
+    class tree_receiver {
+    public:
+        /**
+         * \brief Called for every frame addressed to this node
+         * @param source Node that sent the frame
+         * @param data The data
+         * @param size Size of the data
+         */
+        virtual void tree_received(uint16_t source, const uint8_t *data, uint8_t size) = 0;
+    };
+
+    /**
+     * \brief Node of a tree network, that forwards frames towards their destination
+     *
+     * Frames go down the tree when the destination is in the subtree of this node, and up to the parent otherwise,
+     * unless the route table has a more specific route. The node stays in PRX mode; service() reads all received
+     * frames, and sends all frames waiting to be sent or forwarded in a single visit to PTX mode. Mode changes don't
+     * wait for the module to settle, and TX_ADDR and RX_ADDR_P0 are only written when the next hop changes, and once
+     * when returning to PRX mode.
+     * Frames have a 5 byte header (destination, source, both LSByte first, and a hop limit).
+     * All storage is fixed size, frames that don't fit in the queue are dropped.
+     * @tparam Q Size of the outbound queue, needs to be a power of two
+     * @tparam R Size of the route table
+     * @tparam Radio Driver type, nrf24l01plus or another basic_nrf24l01plus
+     */
+    template<size_t Q = 8, size_t R = 4, typename Radio = nrf24l01plus>
+    class tree_network {
+    public:
+        //! Size of the frame header
+        static constexpr const uint8_t HEADER_SIZE = 5;
+        //! Largest amount of data per frame
+        static constexpr const uint8_t MAX_DATA = 32 - HEADER_SIZE;
+
+        //! Hop limit of new frames
+        uint8_t max_hops = 8;
+        //! Routes overriding the tree
+        tree_route_table<R> routes;
+        //! Amount of frames forwarded for other nodes
+        uint32_t forwarded = 0;
+        //! Amount of frames dropped because the queue was full or the hop limit was reached
+        uint32_t dropped = 0;
+        //! Amount of frames that were not acknowledged by the next hop
+        uint32_t failed = 0;
+        //! Time to wait for TX_DS or MAX_RT before giving up on a frame, in microseconds
+        uint_fast64_t ack_timeout_us = 100000;
+
+    private:
+        Radio &nrf;
+        uint16_t network;
+        uint16_t node;
+        tree_receiver *receiver = nullptr;
+        spsc_ring<packet, Q> outbound;
+        uint16_t current_hop;
+
+    public:
+        /**
+         * \brief Create a node, and configure its pipes
+         *
+         * The module needs to be powered up, DPL and auto acknowledgement are enabled on all pipes.
+         * @param nrf The module to use
+         * @param network Network identifier, shared by all nodes
+         * @param node Address of this node, see tree_address
+         */
+        tree_network(Radio &nrf, uint16_t network, uint16_t node) :
+                nrf(nrf), network(network), node(node), current_hop(node) {
+            for (uint8_t pipe = 0; pipe < 6; pipe++) {
+                address pipe_address = tree_address::pipe_address(network, node, pipe);
+                nrf.rx_set_address(pipe, pipe_address);
+            }
+            nrf.rx_enabled(true);
+            nrf.rx_auto_acknowledgement(true);
+            nrf.feature(NRF_FEATURE::EN_DPL, true);
+            nrf.rx_set_dynamic_payload_length(true);
+            nrf.mode(nrf.MODE_PRX);
+        }
+
+        tree_network(const tree_network &) = delete;
+
+        tree_network &operator=(const tree_network &) = delete;
+
+        /**
+         * \brief Set the receiver for frames addressed to this node
+         */
+        void set_receiver(tree_receiver *data_receiver) {
+            receiver = data_receiver;
+        }
+
+        /**
+         * \brief Address of this node
+         */
+        uint16_t address_of() const {
+            return node;
+        }
+
+        /**
+         * \brief Neighbour a frame for a destination is sent to
+         */
+        uint16_t next_hop(uint16_t destination) const {
+            uint16_t hop;
+            if (routes.lookup(destination, hop)) {
+                return hop;
+            }
+            if (destination != node && tree_address::in_subtree(destination, node)) {
+                return tree_address::child_toward(node, destination);
+            }
+            return tree_address::parent(node);
+        }
+
+        /**
+         * \brief Queue a frame, it is sent on the next call to service()
+         * @param destination Address of the destination node
+         * @param data The data
+         * @param size Size of the data, at most MAX_DATA bytes
+         * @return False if the queue is full or the data is too large
+         */
+        bool send(uint16_t destination, const uint8_t *data, uint8_t size) {
+            if (size > MAX_DATA) {
+                return false;
+            }
+            packet frame = {};
+            frame.data[0] = destination;
+            frame.data[1] = destination >> 8;
+            frame.data[2] = node;
+            frame.data[3] = node >> 8;
+            frame.data[4] = max_hops;
+            for (uint8_t i = 0; i < size; i++) {
+                frame.data[HEADER_SIZE + i] = data[i];
+            }
+            frame.length = HEADER_SIZE + size;
+            return outbound.push(frame);
+        }
+
+        /**
+         * \brief Handle received frames, and send queued frames
+         *
+         * Should be called regularly
+         */
+        void service() {
+            nrf.rx_drain([&](uint8_t, const uint8_t *data, uint8_t width) {
+                if (width < HEADER_SIZE) {
+                    return;
+                }
+                uint16_t destination = data[0] | data[1] << 8;
+                if (destination == node) {
+                    if (receiver != nullptr) {
+                        receiver->tree_received(data[2] | data[3] << 8, data + HEADER_SIZE, width - HEADER_SIZE);
+                    }
+                    return;
+                }
+                packet frame = {};
+                for (uint8_t i = 0; i < width; i++) {
+                    frame.data[i] = data[i];
+                }
+                frame.length = width;
+                if (frame.data[4] == 0) {
+                    dropped++;
+                    return;
+                }
+                frame.data[4]--;
+                if (!outbound.push(frame)) {
+                    dropped++;
+                    return;
+                }
+                forwarded++;
+            });
+
+            if (!outbound.empty()) {
+                flush();
+            }
+        }
+
+    private:
+        void flush() {
+            // Entering PTX doesn't need to settle, the first CE pulse covers the PLL settling time
+            nrf.mode_start(nrf.MODE_PTX);
+            packet frame;
+            while (outbound.pop(frame)) {
+                uint16_t destination = frame.data[0] | frame.data[1] << 8;
+                uint16_t hop = next_hop(destination);
+                if (hop == node) {
+                    dropped++;
+                    continue;
+                }
+                if (hop != current_hop) {
+                    // The parent is reached on the pipe of this node's digit, every other neighbour on its pipe 0
+                    uint8_t pipe = hop == tree_address::parent(node) && node != tree_address::ROOT ?
+                                   tree_address::parent_pipe(node) : 0;
+                    address target = tree_address::pipe_address(network, hop, pipe);
+                    nrf.tx_set_address(target);
+                    nrf.rx_set_address(0, target);
+                    current_hop = hop;
+                }
+                if (!transmit(frame)) {
+                    failed++;
+                }
+            }
+
+            if (current_hop != node) {
+                address own = tree_address::pipe_address(network, node, 0);
+                nrf.rx_set_address(0, own);
+                current_hop = node;
+            }
+            // Frames that arrive while PRX settles are retransmitted by their sender
+            nrf.mode_start(nrf.MODE_PRX);
+        }
+
+        bool transmit(const packet &frame) {
+            nrf.tx_write_payload(frame.data, frame.length);
+            uint_fast64_t deadline = hwlib::now_us() + ack_timeout_us;
+            do {
+                nrf.no_operation();
+            } while ((nrf.last_status & (NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT)) == 0 && hwlib::now_us() < deadline);
+            bool success = (nrf.last_status & NRF_STATUS::TX_DS) != 0;
+            if (!success) {
+                nrf.tx_flush();
+            }
+            nrf.write_register(NRF_REGISTER::NRF_STATUS, uint8_t(NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT));
+            return success;
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //PROJECT_NRF24L01_TREE_NETWORK_HPP
@@ -0,0 +1,54 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+
+using namespace nrf24l01;
+
+// Addresses are usable as constants, an out of range width must not make that ill-formed
+static_assert(address(1, 2, 3, 4, 5).value() == 0x0102030405, "bytes are packed first byte first");
+static_assert(address(0x0102030405, 3).value() == 0x030405, "bytes outside the width are dropped");
+static_assert(address(0x0102030405, 8).width() == address::MAX_WIDTH, "a width of 8 is taken as 5");
+static_assert(address(0x0102030405, 255) == address(0x0102030405), "a width of 255 is taken as 5");
+
+int main() {
+    const address link(0xE1, 0xE2, 0xE3, 0xE4, 0xE5);
+    CHECK(link.width() == 5);
+    CHECK(link.last_byte() == 0xE5);
+    CHECK(address(link, 0x42).value() == 0xE1E2E3E442);
+
+    // Narrowing keeps the last bytes, widening doesn't bring the dropped bytes back
+    CHECK(link.with_width(3).value() == 0xE3E4E5);
+    CHECK(link.with_width(3).with_width(5).value() == 0xE3E4E5);
+    CHECK(link.with_width(3) != link.with_width(4));
+
+    // Widths outside 3-5 are taken as 5
+    for (uint8_t width : {uint8_t(0), uint8_t(2), uint8_t(6), uint8_t(8), uint8_t(64), uint8_t(255)}) {
+        CHECK(address(link.value(), width) == link);
+        CHECK(link.with_width(3).with_width(width).width() == 5);
+    }
+
+    // SPI byte order is LSByte first, to_bytes() always writes 5 bytes
+    uint8_t bytes[8] = {0};
+    link.with_width(4).to_bytes(bytes);
+    CHECK(bytes[0] == 0xE5 && bytes[3] == 0xE2 && bytes[4] == 0);
+    CHECK(address::from_bytes(bytes, 4) == link.with_width(4));
+
+    // from_bytes() never reads beyond 5 bytes
+    uint8_t long_bytes[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    CHECK(address::from_bytes(long_bytes, 8) == address::from_bytes(long_bytes));
+    CHECK(address::from_bytes(long_bytes, 8).value() == 0x0504030201);
+
+    // Equal addresses hash equal, the width is part of both
+    CHECK(link.hash() == address(0xE1E2E3E4E5).hash());
+    CHECK(link == address(0xE1E2E3E4E5));
+    CHECK(address(0xE3E4E5, 3) != address(0xE3E4E5, 5));
+
+    return nrf24l01_test::result("address");
+}
@@ -0,0 +1,126 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/async_tx.hpp>
+
+using namespace nrf24l01;
+
+/**
+ * \brief Records the completions it is notified of
+ */
+struct completion_recorder : tx_completion_listener {
+    int calls = 0;
+    bool success = false;
+
+    void tx_complete(bool result, uint8_t) override {
+        calls++;
+        success = result;
+    }
+};
+
+static const address link(1, 2, 3, 4, 5);
+
+template<typename T>
+static typename T::state run(T &transmitter, uint_fast64_t limit_us = 200000) {
+    uint_fast64_t start = hwlib::now_us();
+    while (transmitter.busy() && hwlib::now_us() - start < limit_us) {
+        transmitter.poll();
+    }
+    return transmitter.get_state();
+}
+
+static void test_polled() {
+    simulated_medium air;
+    simulated_nrf24l01plus a, b;
+    air.attach(a);
+    air.attach(b);
+    nrf24l01plus tx(a, a.csn, a.ce), rx(b, b.csn, b.ce);
+    tx.tx_set_address(link);
+    tx.rx_set_address(0, link);
+    rx.rx_set_address(1, link);
+    rx.rx_set_payload_width(1, 4);
+    nrf24l01_test::power_up({&tx, &rx});
+    rx.mode(rx.MODE_PRX);
+
+    async_transmitter transmitter(tx);
+    completion_recorder recorder;
+    uint8_t data[4] = {1, 2, 3, 4};
+    CHECK(transmitter.send(data, 4, false, &recorder));
+    CHECK(transmitter.busy());
+    CHECK(!transmitter.send(data, 4));
+    CHECK(run(transmitter) == async_transmitter<>::state::done);
+    CHECK(recorder.calls == 1 && recorder.success);
+    CHECK(b.rx_fifo_count() == 1);
+    CHECK(transmitter.last_retries() == 0);
+    CHECK((tx.clear_interrupts() & NRF_STATUS::TX_DS) == 0);
+
+    // The receiver is gone: the transmission fails on MAX_RT, after the configured retries
+    rx.mode(rx.MODE_NONE);
+    CHECK(transmitter.send(data, 4, false, &recorder));
+    CHECK(run(transmitter) == async_transmitter<>::state::failed);
+    CHECK(recorder.calls == 2 && !recorder.success);
+    CHECK(transmitter.last_retries() == 3);
+    CHECK(a.tx_fifo_count() == 0);
+}
+
+static void test_irq_driven() {
+    simulated_medium air;
+    simulated_nrf24l01plus a, b;
+    air.attach(a);
+    air.attach(b);
+    nrf24l01plus tx(a, a.csn, a.ce), rx(b, b.csn, b.ce);
+    tx.tx_set_address(link);
+    tx.rx_set_address(0, link);
+    rx.rx_set_address(1, link);
+    rx.rx_set_payload_width(1, 4);
+    nrf24l01_test::power_up({&tx, &rx});
+    rx.mode(rx.MODE_PRX);
+
+    irq_dispatcher dispatcher(tx, a.irq);
+    async_transmitter transmitter(tx, true);
+    CHECK(dispatcher.add(transmitter));
+
+    uint8_t data[4] = {5, 6, 7, 8};
+    for (int i = 0; i < 3; i++) {
+        CHECK(transmitter.send(data, 4));
+        uint_fast64_t start = hwlib::now_us();
+        while (transmitter.busy() && hwlib::now_us() - start < 200000) {
+            dispatcher.poll();
+            transmitter.poll();
+        }
+        CHECK(transmitter.get_state() == async_transmitter<>::state::done);
+    }
+    CHECK(b.rx_fifo_count() == 3);
+    CHECK(a.irq.read());
+}
+
+static void test_timeout() {
+    simulated_medium air;
+    simulated_nrf24l01plus a;
+    air.attach(a);
+    nrf24l01plus tx(a, a.csn, a.ce);
+
+    // Never powered up, so neither TX_DS nor MAX_RT is ever set
+    async_transmitter transmitter(tx);
+    transmitter.ack_timeout_us = 5000;
+    completion_recorder recorder;
+    uint8_t data[4] = {0};
+    CHECK(transmitter.send(data, 4, false, &recorder));
+    CHECK(run(transmitter) == async_transmitter<>::state::failed);
+    CHECK(recorder.calls == 1 && !recorder.success);
+    CHECK(a.tx_fifo_count() == 0);
+}
+
+int main() {
+    test_polled();
+    test_irq_driven();
+    test_timeout();
+    return nrf24l01_test::result("async_tx");
+}
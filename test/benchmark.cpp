@@ -0,0 +1,75 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/benchmark.hpp>
+
+using namespace nrf24l01;
+
+static const address link(1, 2, 3, 4, 5);
+static const uint32_t ITERATIONS = 200;
+
+/**
+ * \brief Runs the benchmarks against the simulated module and prints the report
+ *
+ * The SPI traffic per iteration doesn't depend on the speed of the host, so it is checked exactly.
+ */
+int main() {
+    simulated_medium air;
+    simulated_nrf24l01plus device, sender_device;
+    air.attach(device);
+    air.attach(sender_device);
+
+    counting_bus bus(device);
+    counting_pin csn(device.csn);
+    nrf24l01plus nrf(bus, csn, device.ce);
+    nrf24l01plus sender(sender_device, sender_device.csn, sender_device.ce);
+    sender.tx_set_address(link);
+    sender.rx_set_address(0, link);
+    nrf.rx_set_address(1, link);
+    nrf.rx_set_payload_width(1, 32);
+    nrf24l01_test::power_up({&nrf, &sender});
+    sender.mode(sender.MODE_PTX);
+
+    benchmark<> bench(bus, csn);
+    benchmark_result results[4] = {
+            bench.register_configuration(nrf, ITERATIONS),
+            bench.mode_switch(nrf, 20),
+            bench.tx_write_payload(nrf, ITERATIONS),
+    };
+    nrf.mode(nrf.MODE_PRX);
+    uint8_t payload[32] = {0};
+    results[3] = bench.rx_read_payload(nrf, ITERATIONS, 32, [&] {
+        sender.tx_burst(payload, 1, 32);
+    });
+    write_report(hwlib::cout, results, 4);
+
+    // One write per register, the addresses take 6 bytes each; rate and power read RF_SETUP first
+    CHECK(results[0].spi_transactions == ITERATIONS * 9);
+    CHECK(results[0].spi_bytes == ITERATIONS * (7 * 2 + 2 * 6));
+    CHECK(results[1].failures == 0);
+
+    // One W_TX_PAYLOAD_NOACK per payload, the wait for TX_DS is not counted
+    CHECK(results[2].failures == 0);
+    CHECK(results[2].spi_transactions == ITERATIONS);
+    CHECK(results[2].spi_bytes == ITERATIONS * 33);
+
+    CHECK(results[3].failures == 0);
+    CHECK(results[3].spi_transactions == ITERATIONS);
+    CHECK(results[3].spi_bytes == ITERATIONS * 33);
+    CHECK(device.rx_fifo_count() == 0);
+
+    // A module that never finishes a transmission doesn't hang the benchmark
+    nrf.power(false);
+    bench.tx_timeout_us = 2000;
+    CHECK(bench.tx_write_payload(nrf, 5).failures == 5);
+    CHECK(device.tx_fifo_count() == 0);
+
+    return nrf24l01_test::result("benchmark");
+}
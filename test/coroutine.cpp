@@ -0,0 +1,96 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/coroutine.hpp>
+
+using namespace nrf24l01;
+
+//! Driver on the simulated module's own bus and pin types, so transactions take the direct path
+using simulated_radio = basic_nrf24l01plus<simulated_nrf24l01plus, simulated_nrf24l01plus::pin>;
+
+static uint32_t sent = 0, received = 0, ticks = 0;
+
+template<typename Radio>
+static radio_task sender(coroutine_radio<Radio> &radio, uint8_t count) {
+    uint8_t data[8] = {0};
+    for (uint8_t i = 0; i < count; i++) {
+        data[0] = i;
+        if (co_await radio.send(data, 8)) {
+            sent++;
+        }
+    }
+}
+
+template<typename Radio>
+static radio_task receiver(coroutine_radio<Radio> &radio) {
+    packet p;
+    while (true) {
+        if (co_await radio.receive(p) && p.length == 8 && p.data[0] == received) {
+            received++;
+        }
+    }
+}
+
+template<typename Radio>
+static radio_task ticker(coroutine_radio<Radio> &radio) {
+    while (true) {
+        co_await radio.delay(1000);
+        ticks++;
+    }
+}
+
+int main() {
+    simulated_medium air;
+    simulated_nrf24l01plus a, b;
+    air.attach(a);
+    air.attach(b);
+    simulated_radio nrf_a(a, a.csn, a.ce), nrf_b(b, b.csn, b.ce);
+    address link(1, 2, 3, 4, 5);
+    nrf_a.tx_set_address(link);
+    nrf_a.rx_set_address(0, link);
+    nrf_b.rx_set_address(1, link);
+    nrf_b.rx_set_payload_width(1, 8);
+    nrf24l01_test::power_up({&nrf_a, &nrf_b});
+    coroutine_radio radio_a(nrf_a), radio_b(nrf_b);
+    const size_t frames = coroutine_frame_pool::available();
+
+    // Tasks destroyed while they are suspended (receiving, sleeping, sending and waiting to send) unlink their waiters
+    {
+        radio_task r = receiver(radio_b), t = ticker(radio_b), s = sender(radio_a, 5), s2 = sender(radio_a, 5);
+        CHECK(r.valid() && t.valid() && s.valid() && s2.valid());
+        CHECK(coroutine_frame_pool::available() == frames - 4);
+        radio_a.poll();
+        radio_b.poll();
+        hwlib::wait_us(3000);
+        radio_b.poll();
+        CHECK(ticks >= 1);
+    }
+    CHECK(coroutine_frame_pool::available() == frames);
+
+    // The frames are reused; a stale waiter would now resume a destroyed coroutine
+    sent = 0;
+    received = 0;
+    radio_task r = receiver(radio_b), s = sender(radio_a, 20);
+    uint_fast64_t deadline = hwlib::now_us() + 1000000;
+    while (!s.done() && hwlib::now_us() < deadline) {
+        radio_a.poll();
+        radio_b.poll();
+    }
+    for (int i = 0; i < 100; i++) {
+        radio_a.poll();
+        radio_b.poll();
+    }
+    CHECK(s.done());
+    CHECK(sent == 20);
+    CHECK(received == 20);
+    CHECK(a.tx_fifo_count() == 0);
+
+    return nrf24l01_test::result("coroutine");
+}
@@ -0,0 +1,95 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/duty_cycle.hpp>
+
+using namespace nrf24l01;
+
+static const address link(1, 2, 3, 4, 5);
+
+struct duty_setup {
+    simulated_medium air;
+    simulated_nrf24l01plus node_device, sender_device;
+    nrf24l01plus node, sender;
+
+    duty_setup() : node(node_device, node_device.csn, node_device.ce),
+                   sender(sender_device, sender_device.csn, sender_device.ce) {
+        air.attach(node_device);
+        air.attach(sender_device);
+        node.rx_set_address(1, link);
+        node.rx_set_payload_width(1, 4);
+        sender.tx_set_address(link);
+        sender.rx_set_address(0, link);
+        nrf24l01_test::power_up({&sender});
+        sender.mode(sender.MODE_PTX);
+    }
+};
+
+/**
+ * \brief Call service() until the receiver enters or leaves the listening state, or until a deadline
+ * @return Time right after the service() call that changed the state, or the deadline
+ */
+template<typename Receiver>
+static uint_fast64_t run_until(Receiver &receiver, bool listening, uint_fast64_t deadline) {
+    uint_fast64_t now = hwlib::now_us();
+    while (now < deadline) {
+        receiver.service();
+        now = hwlib::now_us();
+        if ((receiver.get_state() == Receiver::state::listening) == listening) {
+            break;
+        }
+    }
+    return now;
+}
+
+static void test_first_window() {
+    duty_setup setup;
+    duty_cycle_receiver<> receiver(setup.node, 20000, 2000);
+
+    // The module powers up first, then listens for the full window length
+    uint_fast64_t start = hwlib::now_us();
+    receiver.start();
+    uint_fast64_t opened = run_until(receiver, true, start + 10000);
+    CHECK(receiver.get_state() == decltype(receiver)::state::listening);
+    CHECK(opened - start >= 1500);
+    CHECK(opened - start < 3000);
+    // The times are taken after service() returned, give or take the duration of one call
+    uint_fast64_t closed = run_until(receiver, false, opened + 10000);
+    CHECK(closed - opened + 100 >= 2000);
+    CHECK(closed - opened < 3000);
+    CHECK(receiver.get_state() == decltype(receiver)::state::power_down);
+}
+
+static void test_window_into_next() {
+    duty_setup setup;
+    duty_cycle_receiver<> receiver(setup.node, 10000, 2000);
+    receiver.extend_us = 10500;
+
+    uint_fast64_t start = hwlib::now_us();
+    receiver.start();
+    uint_fast64_t opened = run_until(receiver, true, start + 10000);
+    CHECK(receiver.get_state() == decltype(receiver)::state::listening);
+
+    // The payload stretches the window into the next one, which is already open when this one closes
+    uint8_t data[4] = {1, 2, 3, 4};
+    CHECK(setup.sender.tx_burst(data, 1, 4));
+    uint_fast64_t closed = run_until(receiver, false, opened + 30000);
+    CHECK(receiver.statistics().delivered == 1);
+    // Second window: opens one period after the first one (1500us after start), listened to until its end
+    CHECK(closed - start >= 1500 + 10000 + 2000);
+    CHECK(closed - start < 1500 + 10000 + 3000);
+    CHECK(receiver.get_state() == decltype(receiver)::state::power_down);
+}
+
+int main() {
+    test_first_window();
+    test_window_into_next();
+    return nrf24l01_test::result("duty_cycle");
+}
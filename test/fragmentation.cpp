@@ -0,0 +1,141 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/fragmentation.hpp>
+
+using namespace nrf24l01;
+
+/**
+ * \brief Build a fragment with a given header and a filler byte as data
+ * @return Width of the fragment
+ */
+static uint8_t fragment(uint8_t *payload, uint8_t id, uint8_t index, bool first, bool last, uint8_t length = 30) {
+    payload[0] = id << 4 | (first ? NRF_FRAGMENT::FIRST : 0) | (last ? NRF_FRAGMENT::LAST : 0);
+    payload[1] = index;
+    for (uint8_t i = 0; i < length; i++) {
+        payload[NRF_FRAGMENT::HEADER_SIZE + i] = index;
+    }
+    return NRF_FRAGMENT::HEADER_SIZE + length;
+}
+
+static void test_transfer() {
+    simulated_medium air;
+    simulated_nrf24l01plus a, b;
+    air.attach(a);
+    air.attach(b);
+    nrf24l01plus tx(a, a.csn, a.ce), rx(b, b.csn, b.ce);
+    address link(1, 2, 3, 4, 5);
+    tx.tx_set_address(link);
+    tx.rx_set_address(0, link);
+    rx.rx_set_address(1, link);
+    for (auto *nrf : {&tx, &rx}) {
+        nrf->feature(NRF_FEATURE::EN_DPL, true);
+        nrf->rx_set_dynamic_payload_length(true);
+    }
+    nrf24l01_test::power_up({&tx, &rx});
+    rx.mode(rx.MODE_PRX);
+    tx.mode(tx.MODE_PTX);
+
+    // 75 bytes: three fragments, the last one 15 bytes long, all fit in the RX FIFO
+    uint8_t message[75];
+    for (uint8_t i = 0; i < sizeof(message); i++) {
+        message[i] = i * 3;
+    }
+    fragment_sender sender(tx);
+    CHECK(sender.send(message, sizeof(message)));
+    CHECK(b.rx_fifo_count() == 3);
+
+    fragment_reassembler<128> reassembler;
+    uint8_t completed = 0;
+    rx.rx_drain([&](uint8_t pipe, const uint8_t *data, uint8_t width) {
+        if (reassembler.accept(pipe, data, width)) {
+            completed++;
+            CHECK(reassembler.message_size(pipe) == sizeof(message));
+            bool same = true;
+            for (uint8_t i = 0; i < sizeof(message); i++) {
+                same &= reassembler.message(pipe)[i] == message[i];
+            }
+            CHECK(same);
+        }
+    });
+    CHECK(completed == 1);
+    CHECK(reassembler.dropped == 0);
+}
+
+static void test_loss() {
+    fragment_reassembler<128> reassembler;
+    uint8_t payload[32];
+
+    // Fragment 1 of message 3 is lost: the rest of the message is ignored
+    CHECK(!reassembler.accept(1, payload, fragment(payload, 3, 0, true, false), 0));
+    CHECK(!reassembler.accept(1, payload, fragment(payload, 3, 2, false, false), 10));
+    CHECK(reassembler.dropped == 1);
+    CHECK(!reassembler.accept(1, payload, fragment(payload, 3, 3, false, true), 20));
+    CHECK(reassembler.message(1) == nullptr);
+    CHECK(reassembler.dropped == 1);
+
+    // The first fragment of a new message, while one is incomplete, drops the old one
+    CHECK(!reassembler.accept(1, payload, fragment(payload, 4, 0, true, false), 30));
+    CHECK(!reassembler.accept(1, payload, fragment(payload, 5, 0, true, false), 40));
+    CHECK(reassembler.dropped == 2);
+    CHECK(reassembler.accept(1, payload, fragment(payload, 5, 1, false, true, 5), 50));
+    CHECK(reassembler.message_size(1) == 35);
+
+    // A fragment from another message id is not appended
+    CHECK(!reassembler.accept(2, payload, fragment(payload, 6, 0, true, false), 60));
+    CHECK(!reassembler.accept(2, payload, fragment(payload, 7, 1, false, true), 70));
+    CHECK(reassembler.dropped == 3);
+
+    // Pipes are reassembled independently
+    CHECK(!reassembler.accept(3, payload, fragment(payload, 1, 0, true, false), 80));
+    CHECK(!reassembler.accept(4, payload, fragment(payload, 1, 0, true, false), 80));
+    CHECK(reassembler.accept(4, payload, fragment(payload, 1, 1, false, true), 90));
+    CHECK(reassembler.accept(3, payload, fragment(payload, 1, 1, false, true), 90));
+    CHECK(reassembler.message_size(3) == 60 && reassembler.message_size(4) == 60);
+
+    // A message larger than the buffer is dropped
+    fragment_reassembler<50> small;
+    CHECK(!small.accept(0, payload, fragment(payload, 2, 0, true, false), 0));
+    CHECK(!small.accept(0, payload, fragment(payload, 2, 1, false, true), 10));
+    CHECK(small.message(0) == nullptr);
+    CHECK(small.dropped == 1);
+}
+
+static void test_expiry() {
+    fragment_reassembler<128> reassembler(1000);
+    uint8_t payload[32];
+
+    // The last fragment arrives after the timeout
+    CHECK(!reassembler.accept(1, payload, fragment(payload, 1, 0, true, false), 5000));
+    CHECK(!reassembler.accept(1, payload, fragment(payload, 1, 1, false, true), 6001));
+    CHECK(reassembler.dropped == 1);
+    CHECK(reassembler.message(1) == nullptr);
+
+    // Just within the timeout
+    CHECK(!reassembler.accept(1, payload, fragment(payload, 2, 0, true, false), 7000));
+    CHECK(reassembler.accept(1, payload, fragment(payload, 2, 1, false, true), 8000));
+    CHECK(reassembler.dropped == 1);
+
+    // expire() drops a stalled message without another fragment arriving
+    CHECK(!reassembler.accept(2, payload, fragment(payload, 3, 0, true, false), 9000));
+    reassembler.expire(9500);
+    CHECK(reassembler.dropped == 1);
+    reassembler.expire(10001);
+    CHECK(reassembler.dropped == 2);
+    CHECK(!reassembler.accept(2, payload, fragment(payload, 3, 1, false, true), 10002));
+    CHECK(reassembler.dropped == 2);
+}
+
+int main() {
+    test_transfer();
+    test_loss();
+    test_expiry();
+    return nrf24l01_test::result("fragmentation");
+}
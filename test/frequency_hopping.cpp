@@ -0,0 +1,161 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/frequency_hopping.hpp>
+
+using namespace nrf24l01;
+
+/**
+ * \brief Counts the data frames the follower received
+ */
+struct frame_counter : hopping_receiver {
+    uint32_t frames = 0;
+
+    void hop_received(const uint8_t *, uint8_t) override {
+        frames++;
+    }
+};
+
+static const uint8_t FIRST_CHANNEL = 2;
+static const uint8_t LAST_CHANNEL = 25;
+static const uint8_t BAD_CHANNELS[3] = {7, 13, 19};
+
+struct link_setup {
+    simulated_medium air;
+    simulated_nrf24l01plus leader_device, follower_device;
+    nrf24l01plus leader_nrf, follower_nrf;
+    hopping_sequence leader_sequence, follower_sequence;
+    hopping_link<> leader, follower;
+    frame_counter counter;
+
+    link_setup() :
+            leader_nrf(leader_device, leader_device.csn, leader_device.ce),
+            follower_nrf(follower_device, follower_device.csn, follower_device.ce),
+            leader_sequence(1234, FIRST_CHANNEL, LAST_CHANNEL), follower_sequence(1234, FIRST_CHANNEL, LAST_CHANNEL),
+            leader(leader_nrf, leader_sequence, true, 2000), follower(follower_nrf, follower_sequence, false, 2000) {
+        air.attach(leader_device);
+        air.attach(follower_device);
+        address link(1, 2, 3, 4, 5);
+        leader_nrf.tx_set_address(link);
+        leader_nrf.rx_set_address(0, link);
+        follower_nrf.rx_set_address(1, link);
+        for (auto *nrf : {&leader_nrf, &follower_nrf}) {
+            nrf->feature(NRF_FEATURE::EN_DPL, true);
+            nrf->rx_set_dynamic_payload_length(true);
+        }
+        nrf24l01_test::power_up({&leader_nrf, &follower_nrf});
+        // The test runs in real time on a host that may preempt it now and then, a lost frame on a good channel
+        // must not get the channel blacklisted
+        leader.loss_window = 6;
+        leader.loss_threshold = 80;
+        follower.start(&counter);
+        leader.start();
+    }
+
+    /**
+     * \brief Run both ends, keeping the leader supplied with data
+     */
+    void run(uint_fast64_t duration_us, bool follower_running = true) {
+        uint8_t data[10] = {0};
+        uint_fast64_t end = hwlib::now_us() + duration_us;
+        while (hwlib::now_us() < end) {
+            leader.send(data, sizeof(data));
+            leader.poll();
+            if (follower_running) {
+                follower.poll();
+            }
+        }
+    }
+};
+
+static void test_blacklisting() {
+    link_setup link;
+    for (uint8_t channel : BAD_CHANNELS) {
+        link.air.channel_loss[channel] = 100;
+    }
+    link.run(1500000);
+
+    // The lossy channels are dropped on both ends, with the same map in use
+    for (uint8_t channel : BAD_CHANNELS) {
+        CHECK(!link.leader_sequence.allowed_channel(channel));
+        CHECK(!link.follower_sequence.allowed_channel(channel));
+    }
+    CHECK(link.leader_sequence.allowed_count() == LAST_CHANNEL - FIRST_CHANNEL + 1 - 3);
+    CHECK(link.leader.map_epoch() == link.follower.map_epoch());
+    CHECK(link.leader.map_epoch() != 0);
+
+    // From then on hardly anything is lost anymore, only frames dropped while the host was busy
+    uint32_t missed = link.leader.missed;
+    uint32_t frames = link.counter.frames;
+    link.run(200000);
+    CHECK(link.counter.frames > frames + 50);
+    CHECK(link.leader.missed - missed < (link.counter.frames - frames) / 10);
+}
+
+static void test_resync() {
+    link_setup link;
+    link.run(100000);
+    CHECK(link.counter.frames > 20);
+
+    // The follower stops for a while, the leader hops on without it
+    link.run(100000, false);
+    CHECK(link.follower_device.rx_fifo_count() <= 3);
+    link.follower_nrf.rx_flush();
+
+    // The follower loses track and parks; a frame on its parked channel brings it back in sync
+    uint32_t frames = link.counter.frames;
+    link.run(500000);
+    CHECK(link.counter.frames > frames + 50);
+    // The follower hops ahead as soon as it has received a frame, so it may be one slot ahead of the leader
+    CHECK(uint16_t(link.leader.current_slot() - link.follower.current_slot() + 1) <= 2);
+
+    // The leader blacklisted channels while the follower was away, announcing several maps in a row;
+    // the follower has to end up on the last one
+    CHECK(link.leader.map_epoch() == link.follower.map_epoch());
+    CHECK(link.leader_sequence.allowed_count() == link.follower_sequence.allowed_count());
+
+    // Every channel lost for a while: the leader keeps going, and the follower catches up afterwards
+    for (uint8_t channel = FIRST_CHANNEL; channel <= LAST_CHANNEL; channel++) {
+        link.air.channel_loss[channel] = 100;
+    }
+    link.run(50000);
+    for (uint8_t channel = FIRST_CHANNEL; channel <= LAST_CHANNEL; channel++) {
+        link.air.channel_loss[channel] = 0;
+    }
+    frames = link.counter.frames;
+    link.run(500000);
+    CHECK(link.counter.frames > frames + 50);
+}
+
+static void test_ack_timeout() {
+    simulated_medium air;
+    simulated_nrf24l01plus device;
+    air.attach(device);
+    nrf24l01plus nrf(device, device.csn, device.ce);
+    hopping_sequence sequence(1234);
+    hopping_link<> leader(nrf, sequence, true, 2000);
+    leader.ack_timeout_us = 5000;
+
+    // Never powered up, so TX_DS and MAX_RT never arrive: the leader has to keep hopping anyway
+    leader.start();
+    uint_fast64_t end = hwlib::now_us() + 60000;
+    while (hwlib::now_us() < end) {
+        leader.poll();
+    }
+    CHECK(leader.missed >= 5);
+    CHECK(leader.current_slot() >= 10 && leader.current_slot() != UINT16_MAX);
+}
+
+int main() {
+    test_blacklisting();
+    test_resync();
+    test_ack_timeout();
+    return nrf24l01_test::result("frequency_hopping");
+}
@@ -0,0 +1,105 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/multi_radio.hpp>
+
+using namespace nrf24l01;
+
+static const uint8_t RADIOS = 3;
+static const uint32_t PAYLOADS = 300;
+
+static uint8_t channel_of(uint8_t radio) {
+    return 10 + 10 * radio;
+}
+
+int main() {
+    simulated_medium air;
+    simulated_nrf24l01plus gateway_devices[RADIOS], peer_devices[RADIOS];
+    const address peers[RADIOS] = {address(0x1111111111), address(0x2222222222), address(0x3333333333)};
+    const address gateway(0x4444444444);
+
+    // Every gateway radio has a peer of its own, on its own channel
+    cached_nrf24l01plus gateway_0(gateway_devices[0], gateway_devices[0].csn, gateway_devices[0].ce);
+    cached_nrf24l01plus gateway_1(gateway_devices[1], gateway_devices[1].csn, gateway_devices[1].ce);
+    cached_nrf24l01plus gateway_2(gateway_devices[2], gateway_devices[2].csn, gateway_devices[2].ce);
+    nrf24l01plus peer_0(peer_devices[0], peer_devices[0].csn, peer_devices[0].ce);
+    nrf24l01plus peer_1(peer_devices[1], peer_devices[1].csn, peer_devices[1].ce);
+    nrf24l01plus peer_2(peer_devices[2], peer_devices[2].csn, peer_devices[2].ce);
+    cached_nrf24l01plus *gateways[RADIOS] = {&gateway_0, &gateway_1, &gateway_2};
+    nrf24l01plus *peer_nrfs[RADIOS] = {&peer_0, &peer_1, &peer_2};
+
+    radio_manager<4, 8, cached_nrf24l01plus> manager;
+    for (uint8_t i = 0; i < RADIOS; i++) {
+        air.attach(gateway_devices[i]);
+        air.attach(peer_devices[i]);
+        gateways[i]->channel(channel_of(i));
+        peer_nrfs[i]->channel(channel_of(i));
+        peer_nrfs[i]->rx_set_address(1, peers[i]);
+        peer_nrfs[i]->rx_set_payload_width(1, 32);
+    }
+    nrf24l01_test::power_up({&gateway_0, &gateway_1, &gateway_2});
+    nrf24l01_test::power_up({&peer_0, &peer_1, &peer_2});
+    for (uint8_t i = 0; i < RADIOS; i++) {
+        peer_nrfs[i]->mode(peer_nrfs[i]->MODE_PRX);
+        CHECK(manager.add(*gateways[i], nullptr, i) == i);
+    }
+    CHECK(manager.size() == RADIOS);
+    CHECK(manager.radios_on(channel_of(1)) == 0x02);
+
+    // Payloads for every peer go out on the one radio that shares its channel, all of them arrive
+    uint8_t data[32] = {0};
+    uint32_t queued = 0, received[RADIOS] = {0};
+    uint_fast64_t deadline = hwlib::now_us() + 5000000;
+    while (manager.total().sent + manager.total().failed < PAYLOADS && hwlib::now_us() < deadline) {
+        while (queued < PAYLOADS) {
+            uint8_t peer = queued % RADIOS;
+            data[0] = peer;
+            int radio = manager.send(peers[peer], data, 32, manager.radios_on(channel_of(peer)));
+            if (radio < 0) {
+                break;
+            }
+            CHECK(radio == peer);
+            queued++;
+        }
+        manager.service();
+        for (uint8_t i = 0; i < RADIOS; i++) {
+            received[i] += peer_nrfs[i]->rx_drain([&](uint8_t, const uint8_t *payload, uint8_t) {
+                CHECK(payload[0] == i);
+            });
+        }
+    }
+    CHECK(manager.total().sent == PAYLOADS);
+    CHECK(manager.total().failed == 0);
+    for (uint8_t i = 0; i < RADIOS; i++) {
+        CHECK(received[i] == PAYLOADS / RADIOS);
+        CHECK(manager.statistics(i).sent == PAYLOADS / RADIOS);
+    }
+
+    // A payload from a peer ends up in the inbound queue of the radio that received it
+    gateway_1.rx_set_address(1, gateway);
+    gateway_1.rx_set_payload_width(1, 4);
+    gateway_1.rx_enabled(1, true);
+    peer_1.mode(peer_1.MODE_PTX);
+    peer_1.tx_set_address(gateway);
+    peer_1.rx_set_address(0, gateway);
+    uint8_t message[4] = {1, 2, 3, 4};
+    CHECK(peer_1.tx_burst(message, 1, 4));
+    manager.service();
+    packet incoming;
+    uint8_t from = 0;
+    CHECK(manager.receive(incoming, from));
+    CHECK(from == 1);
+    CHECK(incoming.pipe == 1);
+    CHECK(incoming.length == 4 && incoming.data[3] == 4);
+    CHECK(manager.statistics(1).received == 1);
+    CHECK(!manager.receive(incoming, from));
+
+    return nrf24l01_test::result("multi_radio");
+}
@@ -0,0 +1,92 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/packet_pool.hpp>
+
+using namespace nrf24l01;
+
+static void test_allocation() {
+    packet_pool<4> pool;
+    packet *taken[4];
+    for (auto &p : taken) {
+        p = pool.allocate();
+        CHECK(p != nullptr);
+    }
+    CHECK(pool.allocate() == nullptr);
+    CHECK(pool.available() == 0);
+    for (auto *p : taken) {
+        pool.release(p);
+    }
+    CHECK(pool.available() == 4);
+
+    // A packet put back by the allocating side is handed out first, without going through the ring
+    packet *unused = pool.allocate();
+    pool.put_back(unused);
+    CHECK(pool.available() == 4);
+    CHECK(pool.allocate() == unused);
+    CHECK(pool.available() == 3);
+}
+
+static void test_drain_into() {
+    simulated_medium air;
+    simulated_nrf24l01plus a, b;
+    air.attach(a);
+    air.attach(b);
+    nrf24l01plus tx(a, a.csn, a.ce), rx(b, b.csn, b.ce);
+
+    address link(1, 2, 3, 4, 5);
+    tx.tx_set_address(link);
+    tx.rx_set_address(0, link);
+    rx.rx_set_address(1, link);
+    rx.rx_set_payload_width(1, 5);
+    nrf24l01_test::power_up({&tx, &rx});
+    rx.mode(rx.MODE_PRX);
+    tx.mode(tx.MODE_PTX);
+
+    uint8_t data[15];
+    for (uint8_t i = 0; i < 15; i++) {
+        data[i] = i;
+    }
+    tx.tx_burst(data, 3, 5);
+    CHECK(b.rx_fifo_count() == 3);
+
+    // Two packets in the pool: the third payload stays in the RX FIFO
+    packet_pool<2> pool;
+    packet_queue<4> queue;
+    CHECK(rx_drain_into(rx, pool, queue) == 2);
+    CHECK(b.rx_fifo_count() == 1);
+    CHECK(pool.available() == 0);
+
+    uint8_t expected = 0;
+    packet *p = nullptr;
+    while (queue.pop(p)) {
+        CHECK(p->pipe == 1);
+        CHECK(p->length == 5);
+        CHECK(p->data[0] == expected);
+        expected += 5;
+        pool.release(p);
+    }
+
+    CHECK(rx_drain_into(rx, pool, queue) == 1);
+    CHECK(b.rx_fifo_count() == 0);
+    CHECK(queue.pop(p) && p->data[0] == 10);
+    pool.release(p);
+    CHECK(pool.available() == 2);
+
+    // Nothing left: no packet is kept out of the pool
+    CHECK(rx_drain_into(rx, pool, queue) == 0);
+    CHECK(pool.available() == 2);
+}
+
+int main() {
+    test_allocation();
+    test_drain_into();
+    return nrf24l01_test::result("packet_pool");
+}
@@ -0,0 +1,97 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+
+using namespace nrf24l01;
+
+/**
+ * \brief Configure a module through the read-modify-write setters
+ */
+template<typename Radio>
+static void configure(Radio &nrf) {
+    nrf.channel(76);
+    nrf.auto_retransmit(2, 10);
+    nrf.data_rate(NRF_DATA_RATE::RATE_250KBPS);
+    nrf.tx_power(NRF_TX_POWER::POWER_MIN_12DBM);
+    nrf.address_width(4);
+    nrf.tx_set_address(address(0x11223344, 4));
+    nrf.rx_set_address(0, address(0x11223344, 4));
+    nrf.rx_set_address(1, address(0x55667788, 4));
+    nrf.rx_set_address(2, address(0x55667799, 4));
+    nrf.rx_enabled(2, true);
+    nrf.rx_auto_acknowledgement(3, false);
+    nrf.rx_set_payload_width(1, 12);
+    nrf.feature(NRF_FEATURE::EN_DPL | NRF_FEATURE::EN_DYN_ACK, true);
+    nrf.rx_set_dynamic_payload_length(1, true);
+    nrf.feature(NRF_FEATURE::EN_DYN_ACK, false);
+    // Writes of unchanged values, skipped by the cache
+    nrf.channel(76);
+    nrf.rx_enabled(2, true);
+    nrf.interrupt_mask(false, true, false);
+}
+
+static bool same_registers(simulated_nrf24l01plus &a, simulated_nrf24l01plus &b) {
+    for (uint8_t reg = 0; reg <= NRF_REGISTER::FEATURE; reg++) {
+        for (uint8_t i = 0; i < nrf24l01plus::register_width(reg); i++) {
+            if (a.peek_register(reg, i) != b.peek_register(reg, i)) {
+                hwlib::cout << "register " << reg << " byte " << i << " differs" << hwlib::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    simulated_nrf24l01plus plain_device, cached_device, disabled_device;
+    nrf24l01plus plain(plain_device, plain_device.csn, plain_device.ce);
+    cached_nrf24l01plus cached(cached_device, cached_device.csn, cached_device.ce);
+    cached_nrf24l01plus disabled(disabled_device, disabled_device.csn, disabled_device.ce);
+    cached.cache(true);
+
+    configure(plain);
+    configure(cached);
+    configure(disabled);
+
+    // The cache changes the SPI traffic, never the resulting register contents
+    CHECK(same_registers(plain_device, cached_device));
+    CHECK(same_registers(plain_device, disabled_device));
+    CHECK(cached_device.stats.spi_transactions < plain_device.stats.spi_transactions);
+    CHECK(disabled_device.stats.spi_transactions == plain_device.stats.spi_transactions);
+
+    // Reads give the same values, and configuration reads are answered without SPI
+    uint32_t transactions = cached_device.stats.spi_transactions;
+    CHECK(cached.read_register<NRF_REGISTER::RF_CH>() == plain.read_register<NRF_REGISTER::RF_CH>());
+    CHECK(cached.data_rate() == plain.data_rate());
+    CHECK(cached.tx_power() == plain.tx_power());
+    CHECK(cached.tx_get_address() == plain.tx_get_address());
+    CHECK(cached.rx_get_address(2) == plain.rx_get_address(2));
+    CHECK(cached.rx_get_payload_width(1) == plain.rx_get_payload_width(1));
+    CHECK(cached_device.stats.spi_transactions == transactions);
+
+    // Registers the module changes by itself always go to the module
+    cached.fifo_status();
+    CHECK(cached_device.stats.spi_transactions == transactions + 1);
+
+    // After a change behind the driver's back, the cache answers until it is invalidated
+    cached_device.reset();
+    CHECK(cached.read_register<NRF_REGISTER::RF_CH>() == 76);
+    cached.cache_invalidate();
+    CHECK(cached.read_register<NRF_REGISTER::RF_CH>() == 2);
+
+    // Disabling the cache goes back to plain register access
+    cached.cache(false);
+    transactions = cached_device.stats.spi_transactions;
+    cached.channel(40);
+    CHECK(cached_device.peek_register(NRF_REGISTER::RF_CH) == 40);
+    CHECK(cached_device.stats.spi_transactions == transactions + 1);
+
+    return nrf24l01_test::result("register_cache");
+}
@@ -0,0 +1,66 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+
+using namespace nrf24l01;
+
+int main() {
+    simulated_medium air;
+    simulated_nrf24l01plus a, b;
+    air.attach(a);
+    air.attach(b);
+    nrf24l01plus tx(a, a.csn, a.ce), rx(b, b.csn, b.ce);
+
+    // Pipe 1 with a static width, pipe 2 with dynamic payload length
+    address fixed(0xA1A2A3A4A5), dynamic(0xA1A2A3A4B6);
+    rx.rx_set_address(1, fixed);
+    rx.rx_set_payload_width(1, 6);
+    rx.rx_set_address(2, dynamic);
+    rx.rx_enabled(2, true);
+    rx.feature(NRF_FEATURE::EN_DPL, true);
+    rx.rx_set_dynamic_payload_length(2, true);
+    tx.feature(NRF_FEATURE::EN_DPL, true);
+    tx.rx_set_dynamic_payload_length(0, true);
+    nrf24l01_test::power_up({&tx, &rx});
+    rx.mode(rx.MODE_PRX);
+    tx.mode(tx.MODE_PTX);
+
+    uint8_t data[6] = {0, 1, 2, 3, 4, 5};
+    const address *destinations[3] = {&fixed, &dynamic, &fixed};
+    const uint8_t sizes[3] = {6, 3, 6};
+    for (uint8_t i = 0; i < 3; i++) {
+        tx.tx_set_address(*destinations[i]);
+        tx.rx_set_address(0, *destinations[i]);
+        data[0] = i;
+        CHECK(tx.tx_burst(data, 1, sizes[i]));
+    }
+    CHECK(b.rx_fifo_count() == 3);
+
+    uint8_t index = 0;
+    uint32_t transactions = b.stats.spi_transactions;
+    uint8_t count = rx.rx_drain([&](uint8_t pipe, const uint8_t *payload, uint8_t width) {
+        CHECK(index < 3);
+        CHECK(pipe == (index == 1 ? 2 : 1));
+        CHECK(width == sizes[index]);
+        CHECK(payload[0] == index);
+        index++;
+    });
+    // DYNPD once; R_RX_PL_WID, RX_PW_P1 (static pipe only) and R_RX_PAYLOAD per payload;
+    // the R_RX_PL_WID that finds the FIFO empty, and a single RX_DR clear. No FIFO_STATUS reads.
+    CHECK(b.stats.spi_transactions - transactions == 1 + 3 + 2 + 3 + 2);
+    CHECK(count == 3);
+    CHECK(b.rx_fifo_count() == 0);
+    CHECK((rx.clear_interrupts() & NRF_STATUS::RX_DR) == 0);
+
+    // An empty FIFO is found from the status byte alone
+    CHECK(rx.rx_drain([](uint8_t, const uint8_t *, uint8_t) { CHECK(false); }) == 0);
+
+    return nrf24l01_test::result("rx_drain");
+}
@@ -0,0 +1,29 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/self_test.hpp>
+
+using namespace nrf24l01;
+
+int main() {
+    simulated_medium air;
+    simulated_nrf24l01plus device;
+    air.attach(device);
+    nrf24l01plus nrf(device, device.csn, device.ce);
+
+    startup_test test(nrf);
+    test.test_register_reset_states();
+    nrf24l01_test::power_up({&nrf});
+    test.test_one_side_transmission();
+    CHECK(test.all_successful());
+    CHECK(device.stats.packets_sent == 1);
+
+    return nrf24l01_test::result("self_test");
+}
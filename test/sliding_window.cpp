@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/sliding_window.hpp>
+
+using namespace nrf24l01;
+
+struct sequence_checker : window_data_receiver {
+    uint16_t received = 0;
+    bool in_order = true;
+
+    void window_received(const uint8_t *data, uint8_t size) override {
+        uint16_t value = data[0] | data[1] << 8;
+        if (value != received || size != NRF_WINDOW::DATA_SIZE) {
+            in_order = false;
+        }
+        received++;
+    }
+};
+
+/**
+ * \brief Send a stream of numbered frames from a to b, with a share of the frames lost on the channel
+ */
+static void transfer(uint8_t loss_percent, uint16_t total) {
+    simulated_medium air;
+    simulated_nrf24l01plus a, b;
+    air.attach(a);
+    air.attach(b);
+    air.channel_loss[2] = loss_percent;
+    nrf24l01plus tx(a, a.csn, a.ce), rx(b, b.csn, b.ce);
+
+    address link(1, 2, 3, 4, 5);
+    tx.tx_set_address(link);
+    tx.rx_set_address(0, link);
+    rx.rx_set_address(1, link);
+    for (auto *nrf : {&tx, &rx}) {
+        nrf->ack_payload_enabled(true);
+        nrf->feature(NRF_FEATURE::EN_DYN_ACK, true);
+    }
+    nrf24l01_test::power_up({&tx, &rx});
+    rx.mode(rx.MODE_PRX);
+
+    sequence_checker checker;
+    window_sender<16> sender(tx);
+    window_receiver<16> receiver(rx, 1, &checker);
+
+    uint8_t frame[NRF_WINDOW::DATA_SIZE] = {0};
+    uint16_t queued = 0;
+    uint_fast64_t deadline = hwlib::now_us() + 10000000;
+    while (checker.received < total && hwlib::now_us() < deadline) {
+        while (queued < total) {
+            frame[0] = uint8_t(queued);
+            frame[1] = uint8_t(queued >> 8);
+            if (!sender.send(frame, sizeof(frame))) {
+                break;
+            }
+            queued++;
+        }
+        sender.service();
+        receiver.service();
+    }
+    while (!sender.idle() && hwlib::now_us() < deadline) {
+        sender.service();
+        receiver.service();
+    }
+
+    CHECK(checker.received == total);
+    CHECK(checker.in_order);
+    CHECK(receiver.duplicates == 0 || loss_percent != 0);
+    CHECK(sender.idle());
+    CHECK(loss_percent == 0 || sender.retransmitted > 0);
+}
+
+int main() {
+    transfer(0, 200);
+    transfer(20, 200);
+    return nrf24l01_test::result("sliding_window");
+}
@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/snapshot.hpp>
+
+using namespace nrf24l01;
+
+int main() {
+    simulated_nrf24l01plus device;
+    nrf24l01plus nrf(device, device.csn, device.ce);
+
+    register_snapshot reset = take_snapshot(nrf);
+    CHECK(reset == take_snapshot(nrf));
+
+    // Three registers change
+    nrf.channel(90);
+    nrf.auto_retransmit(4, 8);
+    nrf.rx_set_payload_width(1, 20);
+    register_snapshot configured = take_snapshot(nrf);
+    CHECK(configured != reset);
+
+    // Restoring writes exactly the registers that differ
+    uint32_t transactions = device.stats.spi_transactions;
+    CHECK(restore_snapshot(nrf, reset, configured) == 3);
+    CHECK(device.stats.spi_transactions - transactions == 3);
+    CHECK(device.peek_register(NRF_REGISTER::RF_CH) == 0x02);
+    CHECK(device.peek_register(NRF_REGISTER::SETUP_RETR) == 0x03);
+    CHECK(device.peek_register(NRF_REGISTER::RX_PW_P1) == 0);
+    CHECK(take_snapshot(nrf) == reset);
+
+    // Nothing differs, nothing is written
+    transactions = device.stats.spi_transactions;
+    CHECK(restore_snapshot(nrf, reset, reset) == 0);
+    CHECK(device.stats.spi_transactions == transactions);
+
+    // Reading the current state first
+    CHECK(restore_snapshot(nrf, configured) == 3);
+    CHECK(take_snapshot(nrf) == configured);
+
+    // A different address width changes the stored size of the address registers, so every register from
+    // SETUP_AW on is rewritten: 20 of the 22
+    nrf.address_width(3);
+    nrf.tx_set_address(address(0x123456, 3));
+    register_snapshot narrow = take_snapshot(nrf);
+    CHECK(restore_snapshot(nrf, configured, narrow) == 20);
+    CHECK(nrf.address_width() == 5);
+    CHECK(take_snapshot(nrf) == configured);
+    CHECK(nrf.tx_get_address() == address(0xE7E7E7E7E7));
+
+    CHECK(restore_snapshot(nrf, narrow) == 20);
+    CHECK(nrf.address_width() == 3);
+    CHECK(nrf.tx_get_address() == address(0x123456, 3));
+
+    return nrf24l01_test::result("snapshot");
+}
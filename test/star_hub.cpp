@@ -0,0 +1,147 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/star_hub.hpp>
+
+using namespace nrf24l01;
+
+/**
+ * \brief Simulated module that runs a callback right before the next ACK payload is written to it
+ *
+ * Used to let a peer transmit in between the hub draining its RX FIFO and loading a reply.
+ */
+struct late_load_device : simulated_nrf24l01plus {
+    void (*before_ack_payload)(void *) = nullptr;
+    void *context = nullptr;
+
+    void write_read(const size_t &n, const uint8_t *data_out, uint8_t *data_in) override {
+        if (before_ack_payload != nullptr && n == 1 && data_out != nullptr &&
+            (data_out[0] & 0xF8) == NRF_INSTRUCTION::W_ACK_PAYLOAD) {
+            auto callback = before_ack_payload;
+            before_ack_payload = nullptr;
+            callback(context);
+        }
+        simulated_nrf24l01plus::write_read(n, data_out, data_in);
+    }
+};
+
+/**
+ * \brief Send one payload from a peer, and collect the ACK payload that came back with it
+ * @return Size of the ACK payload, 0 if there was none, -1 if the payload was not acknowledged
+ */
+static int peer_send(nrf24l01plus &peer, uint8_t value, uint8_t *reply) {
+    uint8_t data[8] = {value};
+    peer.tx_write_payload(data, sizeof(data));
+    do {
+        peer.no_operation();
+    } while ((peer.last_status & (NRF_STATUS::TX_DS | NRF_STATUS::MAX_RT)) == 0);
+    uint8_t flags = peer.clear_interrupts();
+    if ((flags & NRF_STATUS::MAX_RT) != 0) {
+        peer.tx_flush();
+        return -1;
+    }
+    return peer.tx_read_ack_payload(reply);
+}
+
+int main() {
+    simulated_medium air;
+    late_load_device hub_device;
+    simulated_nrf24l01plus peer_devices[2];
+    air.attach(hub_device);
+    nrf24l01plus hub_nrf(hub_device, hub_device.csn, hub_device.ce);
+    nrf24l01plus peer_a(peer_devices[0], peer_devices[0].csn, peer_devices[0].ce);
+    nrf24l01plus peer_b(peer_devices[1], peer_devices[1].csn, peer_devices[1].ce);
+
+    address base(0xE7, 0xE7, 0xE7, 0xE7, 0);
+    nrf24l01plus *peers[2] = {&peer_a, &peer_b};
+    for (uint8_t i = 0; i < 2; i++) {
+        air.attach(peer_devices[i]);
+        address own(base, 0x10 + i);
+        peers[i]->tx_set_address(own);
+        peers[i]->rx_set_address(0, own);
+        peers[i]->ack_payload_enabled(true);
+    }
+    nrf24l01_test::power_up({&hub_nrf, &peer_a, &peer_b});
+    peer_a.mode(peer_a.MODE_PTX);
+    peer_b.mode(peer_b.MODE_PTX);
+
+    star_hub<4> hub(hub_nrf, base);
+    int pipe_a = hub.attach(0x10);
+    int pipe_b = hub.attach(0x11);
+    CHECK(pipe_a == 1);
+    CHECK(pipe_b == 2);
+    CHECK(hub.attach(0x10) == -1);
+
+    // Payloads end up in the queue of their peer, in order
+    uint8_t reply[32];
+    CHECK(peer_send(peer_a, 1, reply) == 0);
+    CHECK(peer_send(peer_a, 2, reply) == 0);
+    CHECK(peer_send(peer_b, 3, reply) == 0);
+    hub.service();
+    packet p;
+    CHECK(hub.receive(pipe_a, p) && p.data[0] == 1 && p.pipe == pipe_a);
+    CHECK(hub.receive(pipe_a, p) && p.data[0] == 2);
+    CHECK(!hub.receive(pipe_a, p));
+    CHECK(hub.receive(p) && p.pipe == pipe_b && p.data[0] == 3);
+
+    // Replies go out as ACK payload of the next transmission of their peer, and only to that peer
+    uint8_t answer[4] = {0xA0, 1, 2, 3};
+    CHECK(hub.send(pipe_a, answer, sizeof(answer)));
+    CHECK(hub.pending(pipe_a) == 1);
+    hub.service();
+    CHECK(peer_send(peer_b, 4, reply) == 0);
+    CHECK(peer_send(peer_a, 5, reply) == 4 && reply[0] == 0xA0);
+    hub.service();
+    CHECK(hub.pending(pipe_a) == 0);
+    CHECK(peer_send(peer_a, 6, reply) == 0);
+
+    // A reply that waits too long is taken out of the TX FIFO, and loaded again once its peer shows up
+    hub.ack_timeout_us = 1000;
+    answer[0] = 0xB0;
+    CHECK(hub.send(pipe_b, answer, sizeof(answer)));
+    hub.service();
+    hwlib::wait_us(2000);
+    hub.service();
+    CHECK(hub_device.tx_fifo_count() == 0);
+    CHECK(hub.pending(pipe_b) == 1);
+    CHECK(peer_send(peer_b, 7, reply) == 0);
+    hub.service();
+    CHECK(peer_send(peer_b, 8, reply) == 4 && reply[0] == 0xB0);
+    hub.service();
+    CHECK(hub.pending(pipe_b) == 0);
+
+    // A payload that arrives right before its reply is loaded was acknowledged without the reply
+    while (hub.receive(pipe_a, p)) {
+    }
+    answer[0] = 0xA2;
+    CHECK(hub.send(pipe_a, answer, sizeof(answer)));
+    hub_device.context = &peer_a;
+    hub_device.before_ack_payload = [](void *peer) {
+        uint8_t ignored[32];
+        peer_send(*static_cast<nrf24l01plus *>(peer), 10, ignored);
+    };
+    hub.service();
+    CHECK(hub_device.before_ack_payload == nullptr);
+    CHECK(hub_device.rx_fifo_count() == 1);
+    hub.service();
+    CHECK(hub.receive(pipe_a, p) && p.data[0] == 10);
+    CHECK(hub.pending(pipe_a) == 1);
+    CHECK(hub_device.tx_fifo_count() == 1);
+    CHECK(peer_send(peer_a, 11, reply) == 4 && reply[0] == 0xA2);
+    hub.service();
+    CHECK(hub.pending(pipe_a) == 0);
+
+    // Detaching closes the pipe
+    hub.detach(pipe_b);
+    CHECK(!hub.attached(pipe_b));
+    CHECK(peer_send(peer_b, 9, reply) == -1);
+
+    return nrf24l01_test::result("star_hub");
+}
@@ -0,0 +1,56 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef PROJECT_NRF24L01_TEST_HPP
+#define PROJECT_NRF24L01_TEST_HPP
+
+#include <hwlib.hpp>
+#include <nrf24l01plus/nrf24l01plus.hpp>
+#include <nrf24l01plus/simulated_device.hpp>
+
+/**
+ * \brief Minimal checks for the host tests, every test is a separate program that returns nonzero on failure
+ */
+namespace nrf24l01_test {
+    //! Amount of failed checks in this test program
+    inline int failures = 0;
+
+    inline void check(bool condition, const char *expression, const char *file, int line) {
+        if (!condition) {
+            hwlib::cout << file << ":" << line << ": check failed: " << expression << hwlib::endl;
+            failures++;
+        }
+    }
+
+    /**
+     * \brief Print the outcome of a test program
+     * @param name Name of the test
+     * @return Exit code for main()
+     */
+    inline int result(const char *name) {
+        hwlib::cout << name << (failures == 0 ? ": passed" : ": FAILED") << hwlib::endl;
+        return failures == 0 ? 0 : 1;
+    }
+
+    /**
+     * \brief Power up a set of modules and wait until they are in Standby-I
+     * @tparam Radio Driver type of the modules
+     */
+    template<typename Radio = nrf24l01::nrf24l01plus>
+    void power_up(std::initializer_list<Radio *> modules) {
+        for (auto *nrf : modules) {
+            nrf->power(true);
+        }
+        hwlib::wait_us(1600);
+    }
+}
+
+#define CHECK(condition) nrf24l01_test::check((condition), #condition, __FILE__, __LINE__)
+
+#endif //PROJECT_NRF24L01_TEST_HPP
@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+#include <nrf24l01plus/tree_network.hpp>
+
+using namespace nrf24l01;
+
+struct last_frame : tree_receiver {
+    uint16_t source = 0xFFFF;
+    uint8_t data[32] = {0};
+    uint8_t size = 0;
+    uint8_t count = 0;
+
+    void tree_received(uint16_t from, const uint8_t *frame_data, uint8_t frame_size) override {
+        source = from;
+        size = frame_size;
+        for (uint8_t i = 0; i < frame_size; i++) {
+            data[i] = frame_data[i];
+        }
+        count++;
+    }
+};
+
+static void test_addresses() {
+    CHECK(tree_address::valid(011));
+    CHECK(!tree_address::valid(06));
+    CHECK(!tree_address::valid(010));
+    CHECK(tree_address::depth(0) == 0 && tree_address::depth(0213) == 3);
+    CHECK(tree_address::parent(013) == 03);
+    CHECK(tree_address::parent_pipe(013) == 1);
+    CHECK(tree_address::in_subtree(0213, 03));
+    CHECK(!tree_address::in_subtree(0213, 02));
+    CHECK(tree_address::child_toward(0, 0213) == 03);
+}
+
+int main() {
+    test_addresses();
+
+    // root (0) with children 01 and 02, and 011 below 01
+    const uint16_t nodes[4] = {0, 01, 011, 02};
+    simulated_medium air;
+    simulated_nrf24l01plus devices[4];
+    nrf24l01plus root_nrf(devices[0], devices[0].csn, devices[0].ce);
+    nrf24l01plus n1_nrf(devices[1], devices[1].csn, devices[1].ce);
+    nrf24l01plus n11_nrf(devices[2], devices[2].csn, devices[2].ce);
+    nrf24l01plus n2_nrf(devices[3], devices[3].csn, devices[3].ce);
+    for (auto &device : devices) {
+        air.attach(device);
+    }
+    nrf24l01_test::power_up({&root_nrf, &n1_nrf, &n11_nrf, &n2_nrf});
+
+    tree_network<> root(root_nrf, 0xBEEF, nodes[0]);
+    tree_network<> n1(n1_nrf, 0xBEEF, nodes[1]);
+    tree_network<> n11(n11_nrf, 0xBEEF, nodes[2]);
+    tree_network<> n2(n2_nrf, 0xBEEF, nodes[3]);
+    tree_network<> *network[4] = {&root, &n1, &n11, &n2};
+    last_frame received[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        network[i]->set_receiver(&received[i]);
+    }
+    auto run = [&]() {
+        for (uint8_t pass = 0; pass < 4; pass++) {
+            for (auto *n : network) {
+                n->service();
+            }
+        }
+    };
+
+    CHECK(n11.next_hop(0) == 01);
+    CHECK(n11.next_hop(02) == 01);
+    CHECK(root.next_hop(011) == 01);
+
+    // Up, down, and across the root
+    CHECK(n11.send(0, (const uint8_t *) "up", 2));
+    CHECK(root.send(011, (const uint8_t *) "down", 4));
+    run();
+    CHECK(received[0].count == 1 && received[0].source == 011 && received[0].size == 2 && received[0].data[0] == 'u');
+    CHECK(received[2].count == 1 && received[2].source == 0 && received[2].size == 4 && received[2].data[0] == 'd');
+    CHECK(n1.forwarded == 2);
+
+    CHECK(n11.send(02, (const uint8_t *) "across", 6));
+    run();
+    CHECK(received[3].count == 1 && received[3].source == 011 && received[3].data[0] == 'a');
+    CHECK(n1.forwarded == 3 && root.forwarded == 1);
+
+    // The hop limit stops frames at the node where it runs out
+    n11.max_hops = 1;
+    CHECK(n11.send(02, (const uint8_t *) "far", 3));
+    run();
+    CHECK(received[3].count == 1);
+    CHECK(root.dropped == 1);
+
+    // A route overrides the tree, a next hop that doesn't exist is counted as failed
+    CHECK(root.routes.add(02, 03));
+    CHECK(root.next_hop(02) == 03);
+    CHECK(root.send(02, (const uint8_t *) "lost", 4));
+    run();
+    CHECK(root.failed == 1);
+    CHECK(received[3].count == 1);
+
+    return nrf24l01_test::result("tree_network");
+}
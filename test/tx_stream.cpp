@@ -0,0 +1,89 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include "test.hpp"
+
+using namespace nrf24l01;
+
+static const address link(1, 2, 3, 4, 5);
+
+static void test_stream() {
+    simulated_medium air;
+    simulated_nrf24l01plus a, b;
+    air.attach(a);
+    air.attach(b);
+    nrf24l01plus tx(a, a.csn, a.ce), rx(b, b.csn, b.ce);
+    tx.tx_set_address(link);
+    tx.rx_set_address(0, link);
+    rx.rx_set_address(1, link);
+    rx.rx_set_payload_width(1, 4);
+    nrf24l01_test::power_up({&tx, &rx});
+    rx.mode(rx.MODE_PRX);
+    tx.mode(tx.MODE_PTX);
+
+    uint8_t data[4] = {1, 2, 3, 4};
+    tx.tx_stream_begin();
+    for (uint8_t i = 0; i < 3; i++) {
+        data[0] = i;
+        CHECK(tx.tx_stream_write(data, 4));
+    }
+    CHECK(tx.tx_stream_end());
+    CHECK(b.rx_fifo_count() == 3);
+    CHECK(a.tx_fifo_count() == 0);
+}
+
+static void test_max_retransmit() {
+    simulated_medium air;
+    simulated_nrf24l01plus a;
+    air.attach(a);
+    nrf24l01plus tx(a, a.csn, a.ce);
+    tx.tx_set_address(link);
+    tx.rx_set_address(0, link);
+    nrf24l01_test::power_up({&tx});
+    tx.mode(tx.MODE_PTX);
+
+    // Nobody acknowledges: the stream ends on MAX_RT, and the FIFO is flushed
+    uint8_t data[4] = {0};
+    CHECK(!tx.tx_burst(data, 2, 4));
+    CHECK(a.tx_fifo_count() == 0);
+    CHECK((tx.clear_interrupts() & NRF_STATUS::MAX_RT) == 0);
+}
+
+static void test_timeout() {
+    simulated_medium air;
+    simulated_nrf24l01plus a;
+    air.attach(a);
+    nrf24l01plus tx(a, a.csn, a.ce);
+    tx.tx_stream_timeout_us = 20000;
+
+    // Never powered up: the payloads stay in the TX FIFO, nothing ever sets MAX_RT
+    uint8_t data[4] = {0};
+    tx.tx_stream_begin();
+    for (uint8_t i = 0; i < 3; i++) {
+        CHECK(tx.tx_stream_write(data, 4));
+    }
+    uint_fast64_t start = hwlib::now_us();
+    CHECK(!tx.tx_stream_write(data, 4));
+    uint_fast64_t waited = hwlib::now_us() - start;
+    CHECK(waited >= 20000 && waited < 200000);
+    CHECK(a.tx_fifo_count() == 3);
+
+    start = hwlib::now_us();
+    CHECK(!tx.tx_stream_end());
+    waited = hwlib::now_us() - start;
+    CHECK(waited >= 20000 && waited < 200000);
+    CHECK(a.tx_fifo_count() == 0);
+}
+
+int main() {
+    test_stream();
+    test_max_retransmit();
+    test_timeout();
+    return nrf24l01_test::result("tx_stream");
+}